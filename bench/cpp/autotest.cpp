@@ -38,6 +38,7 @@
 //
 // }}}
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include <signal.h>
 #include <poll.h>
@@ -275,6 +276,494 @@ int	test5_scope_data(int fdin, int fdout) {
 }
 // }}}
 
+int	test6_diffaddr(int fdin, int fdout) {
+	// {{{
+	// Difference addresses (addr[1] set) are added to the current bus
+	// address.  After the read of 0x4000, the address has incremented to
+	// 0x4004, so +4 takes us to 0x4008.  Following the write there, a
+	// difference of -4 returns us to 0x4008 to read it back.
+	const char CHECKSTR[] = "A00004000Rdeadbeef\n"
+			"A00004008\nK00000000\n"
+			"A00004008R01234567\n";
+	char	response[512], *rptr;
+
+	getresponse(fdin, fdout, "A4000R\nA6W1234567\nAfffffffeR\n",
+		response);
+
+	rptr = response;
+	while(*rptr && isspace(*rptr))
+		rptr++;
+
+	if (0 != strcmp(rptr, CHECKSTR)) {
+		printf("CHECK6: -- FAILS\n");
+		printf("RCV: %s", rptr);
+		printf("PAT: %s", CHECKSTR);
+
+		return 1;
+	}
+
+	return 0;
+}
+// }}}
+
+int	test7_burst(int fdin, int fdout) {
+	// {{{
+	// Query the capabilities of the bus, then write three words and read
+	// them all back with a single burst read.  Burst responses are
+	// returned back to back, so white space is ignored in the comparison.
+	const char CHECKSTR[] = "R033400ff"
+			"A00004010K00000000K00000000K00000000"
+			"A00004010R11111111R22222222R33333333";
+	char	response[512], stripped[512], *rptr, *sptr;
+
+	getresponse(fdin, fdout, "S\nA4010W11111111\nW22222222\nW33333333\n"
+			"A4010S31\n", response);
+
+	sptr = stripped;
+	for(rptr = response; *rptr; rptr++)
+		if (!isspace(*rptr))
+			*sptr++ = *rptr;
+	*sptr = '\0';
+
+	if (0 != strcmp(stripped, CHECKSTR)) {
+		printf("CHECK7: -- FAILS\n");
+		printf("RCV: %s\n", stripped);
+		printf("PAT: %s\n", CHECKSTR);
+
+		return 1;
+	}
+
+	return 0;
+}
+// }}}
+
+// Number of words written, then read back, by the stress test
+#define	NSTRESS		1024
+
+static	unsigned	stressval(unsigned k) {
+	return (k * 0x9e3779b9u) ^ 0x5a5a5a5a;
+}
+
+int	test8_stress(int fdin, int fdout) {
+	// {{{
+	// Stream NSTRESS writes, the same writes again each behind a byte
+	// enable special, and then NSTRESS reads, through the command FIFO.
+	// Commands are sent back to back, without any pacing, keeping as many
+	// command words in flight as the FIFO reports it can hold--specials
+	// included.  Every command must be answered, and every word read back
+	// as written.  Finally, overflowing the FIFO on purpose must be
+	// reported with a bus error.
+	char	response[512], *rptr, *cmd;
+	unsigned	caps, window, nsent, nrcvd, ln, v = 0, ndigits = 0,
+			nerr = 0, nwords;
+	int	nr;
+	char	rsp = 0;
+
+	getresponse(fdin, fdout, "S\n", response);
+	rptr = response;
+	while(*rptr && isspace(*rptr))
+		rptr++;
+	if (1 != sscanf(rptr, "R%x", &caps)) {
+		printf("CHECK8: -- No capabilities returned\n");
+		return 1;
+	}
+
+	window = 1u << ((caps >> 16) & 0x0f);
+	if (window < 2) {
+		printf("CHECK8: -- No command FIFO\n");
+		return 1;
+	}
+
+	cmd = new char[window * 16 + 2];
+	for(int pass=0; (pass < 3)&&(nerr == 0); pass++) {
+		getresponse(fdin, fdout, "A4000\n", response);
+
+		// Command words per request
+		nwords = (pass == 1) ? 2 : 1;
+
+		nsent = nrcvd = 0;
+		while((nrcvd < NSTRESS)&&(nerr == 0)) {
+			struct	pollfd	fds;
+
+			ln = 0;
+			while((nsent < NSTRESS)
+					&&((nsent - nrcvd + 1) * nwords <= window)) {
+				if (pass == 1)
+					ln += sprintf(&cmd[ln], "Sf3");
+				if (pass < 2)
+					ln += sprintf(&cmd[ln], "W%x",
+						stressval(nsent));
+				else
+					cmd[ln++] = 'R';
+				nsent++;
+			} if (ln > 0) {
+				cmd[ln++] = '\n';
+				assert((int)ln == write(fdin, cmd, ln));
+			}
+
+			fds.fd = fdout;
+			fds.events = POLLIN;
+			if (poll(&fds, 1, 20*TIMEOUT) <= 0) {
+				printf("CHECK8: -- Timeout, %d of %d answered\n",
+					nrcvd, nsent);
+				nerr++;
+				break;
+			}
+
+			nr = read(fdout, response, sizeof(response));
+			for(int k=0; k<nr; k++) {
+				char	ch = response[k];
+
+				if ((rsp)&&(((ch >= '0')&&(ch <= '9'))
+						||((ch >= 'a')&&(ch <= 'f')))) {
+					v = (v << 4) | (ch <= '9' ? ch-'0'
+							: ch-'a'+10);
+					if (++ndigits < 8)
+						continue;
+					if ((pass < 2)&&(rsp == 'K'))
+						nrcvd++;
+					else if ((pass == 2)&&(rsp == 'R')) {
+						if (v != stressval(nrcvd)) {
+							printf("CHECK8: -- [%d] = %08x != %08x\n",
+								nrcvd, v,
+								stressval(nrcvd));
+							nerr++;
+						}
+						nrcvd++;
+					}
+					rsp = 0;
+				} else {
+					rsp = ch; v = 0; ndigits = 0;
+					if (ch == 'E') {
+						printf("CHECK8: -- Bus error\n");
+						nerr++;
+					}
+				}
+			}
+		}
+
+		printf("CHECK8: %d %s\n", nrcvd, (pass == 2) ? "reads"
+				: (pass) ? "byte enabled writes" : "writes");
+	}
+	delete[] cmd;
+
+	if (nerr == 0) {
+		// Each read's response takes ten times as long to send as the
+		// read itself, so this many back to back can't all fit.  Those
+		// lost must be reported.
+		unsigned	nreads = 4 * window + 16;
+		bool		buserr = false;
+		struct	pollfd	fds;
+
+		getresponse(fdin, fdout, "A4000\n", response);
+		cmd = new char[nreads + 2];
+		memset(cmd, 'R', nreads);
+		cmd[nreads] = '\n';
+		assert((int)nreads+1 == write(fdin, cmd, nreads+1));
+		delete[] cmd;
+
+		fds.fd = fdout;
+		fds.events = POLLIN;
+		while(poll(&fds, 1, 4*TIMEOUT) > 0) {
+			nr = read(fdout, response, sizeof(response));
+			if (nr <= 0)
+				break;
+			if (memchr(response, 'E', nr))
+				buserr = true;
+		}
+
+		if (!buserr) {
+			printf("CHECK8: -- FIFO overflow went unreported\n");
+			nerr++;
+		} else
+			printf("CHECK8: FIFO overflow reported\n");
+	}
+
+	return (nerr) ? 1 : 0;
+}
+// }}}
+
+// getbinary
+// {{{
+// Sends len bytes of cmd, and collects the bytes returned until the channel
+// goes quiet.  Any interrupt or idle responses (an escape followed by an 'I'
+// or a 'Z') are dropped along the way.  Returns the number of bytes kept.
+unsigned	getbinary(int fdin, int fdout, const unsigned char *cmd,
+		unsigned len, unsigned char *response, unsigned maxlen) {
+	struct	pollfd	fds;
+	unsigned	posn = 0;
+	int		nr;
+
+	assert((int)len == write(fdin, cmd, len));
+
+	fds.fd = fdout;
+	fds.events = POLLIN;
+	while((posn < maxlen)&&(poll(&fds, 1, 4*TIMEOUT) > 0)) {
+		nr = read(fdout, &response[posn], 1);
+		if (nr <= 0)
+			break;
+		posn++;
+		if ((posn >= 2)&&(response[posn-2] == 0x1b)
+				&&((response[posn-1] == 'I')
+				||(response[posn-1] == 'Z'))) {
+			// Only if the escape wasn't itself escaped
+			unsigned k = posn-2, nesc = 0;
+			while((k > 0)&&(response[k-1] == 0x1b))
+				k--, nesc++;
+			if ((nesc & 1) == 0)
+				posn -= 2;
+		}
+	}
+
+	return posn;
+}
+// }}}
+
+int	test9_binary(int fdin, int fdout) {
+	// {{{
+	// Switch to the binary protocol, write two words and read them back,
+	// then switch back to hexadecimal.  The first word read back contains
+	// an escape character, which must be sent twice.
+	const unsigned char	BINCMD[] = {
+			0xc2, 0x40, 0x10,		// A4010
+			0xa1, 0x1b, 0x2b, 0x3c, 0x4d,	// W1b2b3c4d
+			      0x55, 0x66, 0x77, 0x88,	// W55667788
+			0xc2, 0x40, 0x10,		// A4010
+			0x80, 0x80,			// R, R
+			0xe1, 0x02 },			// S2, to hex
+		BINCHK[] = {
+			0x1b, 'A', 0x00, 0x00, 0x40, 0x10,
+			0x1b, 'K', 0x1b, 'K',
+			0x1b, 'A', 0x00, 0x00, 0x40, 0x10,
+			0x1b, 'R', 0x1b, 0x1b, 0x2b, 0x3c, 0x4d,
+				   0x55, 0x66, 0x77, 0x88,
+			0x1b, 'M' };
+	const char CHECKSTR[] = "A00002040R20170622\n";
+	char	response[512], *rptr;
+	unsigned char	binrsp[512];
+	unsigned	ln;
+
+	// The switch is acknowledged with an 'M' in the old mode
+	getresponse(fdin, fdout, "S12\n", response);
+	rptr = response;
+	while(*rptr && isspace(*rptr))
+		rptr++;
+	if (0 != strcmp(rptr, "M\n")) {
+		printf("CHECK9: -- No switch to binary\n");
+		printf("RCV: %s", rptr);
+		return 1;
+	}
+
+	ln = getbinary(fdin, fdout, BINCMD, sizeof(BINCMD), binrsp,
+			sizeof(binrsp));
+	if ((ln != sizeof(BINCHK))||(0 != memcmp(binrsp, BINCHK, ln))) {
+		printf("CHECK9: -- FAILS\n");
+		printf("RCV:");
+		for(unsigned k=0; k<ln; k++)
+			printf(" %02x", binrsp[k]);
+		printf("\nPAT:");
+		for(unsigned k=0; k<sizeof(BINCHK); k++)
+			printf(" %02x", BINCHK[k]);
+		printf("\n");
+		return 1;
+	}
+
+	// Once back in hexadecimal, everything works as before
+	getresponse(fdin, fdout, "A2040R\n", response);
+	rptr = response;
+	while(*rptr && isspace(*rptr))
+		rptr++;
+	if (0 != strcmp(rptr, CHECKSTR)) {
+		printf("CHECK9: -- No return to hexadecimal\n");
+		printf("RCV: %s", rptr);
+		printf("PAT: %s", CHECKSTR);
+		return 1;
+	}
+
+	return 0;
+}
+// }}}
+
+int	test10_rle(int fdin, int fdout) {
+	// {{{
+	// Turn on read response compression, write one word and then read it
+	// back 32 times with a non-incrementing burst.  While the return
+	// channel is busy, copies are counted rather than sent, so some of
+	// them must come back as a repeat ('D') instead.  Exactly where the
+	// run gets split depends upon the depth of the return chain, so we
+	// only check that the copies add up.
+	const char PREFIX[] = "MA00004010K00000000A00004011";
+	char	response[2048], stripped[2048], *rptr, *sptr;
+	unsigned	ncopies = 0, nrepeats = 0;
+
+	getresponse(fdin, fdout, "S22\nA4010W5a5a5a5a\nA4011S201\nS2\n",
+			response);
+
+	sptr = stripped;
+	for(rptr = response; *rptr; rptr++)
+		if (!isspace(*rptr))
+			*sptr++ = *rptr;
+	*sptr = '\0';
+
+	if (0 != strncmp(stripped, PREFIX, strlen(PREFIX))) {
+		printf("CHECK10: -- FAILS\n");
+		printf("RCV: %s\n", stripped);
+		return 1;
+	}
+
+	for(rptr = &stripped[strlen(PREFIX)]; *rptr; ) {
+		if (*rptr == 'R') {
+			if (0 != strncmp(rptr, "R5a5a5a5a", 9))
+				break;
+			ncopies++;
+			rptr += 9;
+		} else if ((*rptr == 'D')&&(strlen(rptr) >= 9)) {
+			char	count[9];
+
+			memcpy(count, rptr+1, 8);
+			count[8] = '\0';
+			ncopies += strtoul(count, NULL, 16);
+			nrepeats++;
+			rptr += 9;
+		} else if ((*rptr == 'I')||(*rptr == 'Z'))
+			rptr++;
+		else
+			break;
+	}
+
+	if ((0 != strcmp(rptr, "M"))||(ncopies != 32)||(nrepeats == 0)) {
+		printf("CHECK10: -- FAILS, %d copies, %d repeats\n",
+			ncopies, nrepeats);
+		printf("RCV: %s\n", stripped);
+		return 1;
+	}
+
+	return 0;
+}
+// }}}
+
+int	test11_bytes(int fdin, int fdout) {
+	// {{{
+	// Write a word, then write only its bottom two bytes (S33 selects
+	// byte lanes 1 and 0 of the next write), and read the result back.
+	// The byte enables then return to selecting every byte.
+	const char CHECKSTR[] = "A00004020K00000000"
+			"A00004020K00000000K00000000"
+			"A00004020R1122aabbR55667788";
+	char	response[512], stripped[512], *rptr, *sptr;
+
+	getresponse(fdin, fdout, "A4020W11223344\nA4020S33W0000aabb\n"
+			"W55667788\nA4020S21\n", response);
+
+	sptr = stripped;
+	for(rptr = response; *rptr; rptr++)
+		if (!isspace(*rptr))
+			*sptr++ = *rptr;
+	*sptr = '\0';
+
+	if (0 != strcmp(stripped, CHECKSTR)) {
+		printf("CHECK11: -- FAILS\n");
+		printf("RCV: %s\n", stripped);
+		printf("PAT: %s\n", CHECKSTR);
+
+		return 1;
+	}
+
+	return 0;
+}
+// }}}
+
+int	test12_poll(int fdin, int fdout) {
+	// {{{
+	// Write a word, then poll it twice without incrementing the address:
+	// once with a mask and value it already matches, and once with a value
+	// it never will, so that the poll times out after 0x20 clocks.  Either
+	// way, the poll is answered with a single read response.
+	const char CHECKSTR[] = "A00004021K00000000"
+			"R11223344R11223344";
+	char	response[512], stripped[512], *rptr, *sptr;
+
+	getresponse(fdin, fdout, "A4021W11223344\nS104\nWffff\nW3344\n"
+			"S204\nWffffffff\nW0\n", response);
+
+	sptr = stripped;
+	for(rptr = response; *rptr; rptr++)
+		if (!isspace(*rptr))
+			*sptr++ = *rptr;
+	*sptr = '\0';
+
+	if (0 != strcmp(stripped, CHECKSTR)) {
+		printf("CHECK12: -- FAILS\n");
+		printf("RCV: %s\n", stripped);
+		printf("PAT: %s\n", CHECKSTR);
+
+		return 1;
+	}
+
+	return 0;
+}
+// }}}
+
+int	test13_crc(int fdin, int fdout) {
+	// {{{
+	// Write the bytes "12345678" into two words, and ask for their CRC,
+	// which should match zlib's crc32() of the same eight bytes.  The CRC
+	// of no words at all is zero.
+	const char CHECKSTR[] = "A00004030K00000000K00000000"
+			"A00004030R9ae0daafR00000000";
+	char	response[512], stripped[512], *rptr, *sptr;
+
+	getresponse(fdin, fdout, "A4030W31323334\nW35363738\nA4030S25\nS5\n",
+			response);
+
+	sptr = stripped;
+	for(rptr = response; *rptr; rptr++)
+		if (!isspace(*rptr))
+			*sptr++ = *rptr;
+	*sptr = '\0';
+
+	if (0 != strcmp(stripped, CHECKSTR)) {
+		printf("CHECK13: -- FAILS\n");
+		printf("RCV: %s\n", stripped);
+		printf("PAT: %s\n", CHECKSTR);
+
+		return 1;
+	}
+
+	return 0;
+}
+// }}}
+
+int	test14_fillcopy(int fdin, int fdout) {
+	// {{{
+	// Fill two words with a5a5a5a5, copy the two words test13 wrote in
+	// behind them, and read all four back.  Each fill or copy is answered
+	// with a single acknowledgement.
+	const char CHECKSTR[] = "A00004040K00000000A00004048K00000000"
+			"A00004040Ra5a5a5a5Ra5a5a5a5R31323334R35363738";
+	char	response[512], stripped[512], *rptr, *sptr;
+
+	getresponse(fdin, fdout, "A4040S26\nWa5a5a5a5\nA4048S27\nW4030\n"
+			"A4040S41\n", response);
+
+	sptr = stripped;
+	for(rptr = response; *rptr; rptr++)
+		if (!isspace(*rptr))
+			*sptr++ = *rptr;
+	*sptr = '\0';
+
+	if (0 != strcmp(stripped, CHECKSTR)) {
+		printf("CHECK14: -- FAILS\n");
+		printf("RCV: %s\n", stripped);
+		printf("PAT: %s\n", CHECKSTR);
+
+		return 1;
+	}
+
+	return 0;
+}
+// }}}
+
 int	main(int argc, char **argv) {
 	// {{{
 	int	childs_stdin[2], childs_stdout[2];
@@ -314,6 +803,24 @@ int	main(int argc, char **argv) {
 			err = test4_scope_trigger(fdin, fdout);
 		if (0 == err)
 			err = test5_scope_data(fdin, fdout);
+		if (0 == err)
+			err = test6_diffaddr(fdin, fdout);
+		if (0 == err)
+			err = test7_burst(fdin, fdout);
+		if (0 == err)
+			err = test8_stress(fdin, fdout);
+		if (0 == err)
+			err = test9_binary(fdin, fdout);
+		if (0 == err)
+			err = test10_rle(fdin, fdout);
+		if (0 == err)
+			err = test11_bytes(fdin, fdout);
+		if (0 == err)
+			err = test12_poll(fdin, fdout);
+		if (0 == err)
+			err = test13_crc(fdin, fdout);
+		if (0 == err)
+			err = test14_fillcopy(fdin, fdout);
 
 		kill(childs_pid, 15);
 		if (err != 0) {
@@ -64,6 +64,10 @@ public:
 		m_done = false;
 	}
 
+	TESTBUS_TB(const char *sock_path) : m_uart(sock_path) {
+		m_done = false;
+	}
+
 	void	trace(const char *vcd_trace_file_name) {
 		fprintf(stderr, "Opening TRACE(%s)\n", vcd_trace_file_name);
 		opentrace(vcd_trace_file_name);
@@ -105,8 +109,25 @@ TESTBUS_TB	*tb;
 
 int	main(int argc, char **argv) {
 	// {{{
+	const char	*sock_path = NULL;
+
 	Verilated::commandArgs(argc, argv);
-	tb = new TESTBUS_TB(FPGAPORT);
+
+	// -u path listens on a Unix domain socket, rather than on FPGAPORT
+	for(int argn=1; argn<argc; argn++) {
+		if (0 == strcmp(argv[argn], "-u")) {
+			if (argn+1 >= argc) {
+				fprintf(stderr, "ERR: -u requires a socket path, such as %s\n", FPGASOCK);
+				exit(EXIT_FAILURE);
+			}
+			sock_path = argv[++argn];
+		}
+	}
+
+	if (sock_path)
+		tb = new TESTBUS_TB(sock_path);
+	else
+		tb = new TESTBUS_TB(FPGAPORT);
 
 	// tb->opentrace("trace.vcd");
 	tb->reset();
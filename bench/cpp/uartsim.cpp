@@ -41,12 +41,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <poll.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <signal.h>
 #include <ctype.h>
+#include <errno.h>
 
 #include "uartsim.h"
 
@@ -94,15 +97,109 @@ void	UARTSIM::setup_listener(const int port) {
 }
 // }}}
 
+// remove_stale_socket
+// {{{
+// Removes a socket left behind at path by an earlier run.  Anything there that
+// isn't a socket, or is a socket something is still listening on, is left
+// alone, and we give up rather than take its place.
+static	void	remove_stale_socket(const char *path) {
+	struct	stat		sb;
+	struct	sockaddr_un	addr;
+	int	fd;
+
+	if (lstat(path, &sb) != 0) {
+		if (errno == ENOENT)
+			return;
+		perror("ERR: Could not stat socket path:");
+		exit(EXIT_FAILURE);
+	}
+
+	if (!S_ISSOCK(sb.st_mode)) {
+		fprintf(stderr, "ERR: %s exists, and is not a socket\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ((fd >= 0)&&(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)) {
+		fprintf(stderr, "ERR: Something is already listening on %s\n", path);
+		exit(EXIT_FAILURE);
+	}
+	if (fd >= 0)
+		close(fd);
+
+	unlink(path);
+}
+// }}}
+
+// setup_listener(path)
+// {{{
+void	UARTSIM::setup_listener(const char *path) {
+	struct	sockaddr_un	my_addr;
+
+	signal(SIGPIPE, SIG_IGN);
+
+	if (strlen(path) >= sizeof(my_addr.sun_path)) {
+		fprintf(stderr, "ERR: Socket path too long, %s\n", path);
+		exit(EXIT_FAILURE);
+	}
+
+	m_skt = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (m_skt < 0) {
+		perror("ERR: Could not allocate socket: ");
+		exit(EXIT_FAILURE);
+	}
+
+	// This takes the place of SO_REUSEADDR
+	remove_stale_socket(path);
+	printf("Listening on %s\n", path);
+
+	memset(&my_addr, 0, sizeof(struct sockaddr_un)); // clear structure
+	my_addr.sun_family = AF_UNIX;
+	strcpy(my_addr.sun_path, path);
+
+	if (bind(m_skt, (struct sockaddr *)&my_addr, sizeof(my_addr))!=0) {
+		perror("ERR: BIND FAILED:");
+		exit(EXIT_FAILURE);
+	}
+	m_path = strdup(path);
+
+	if (listen(m_skt, 1) != 0) {
+		perror("ERR: Listen failed:");
+		exit(EXIT_FAILURE);
+	}
+}
+// }}}
+
 // UARTSIM::UARTSIM(const int port)
 // {{{
 UARTSIM::UARTSIM(const int port) {
 	m_conrd = m_conwr = m_skt = -1;
+	m_path = NULL;
 	if (port == 0) {
 		m_conrd = STDIN_FILENO;
 		m_conwr = STDOUT_FILENO;
 	} else
 		setup_listener(port);
+	init();
+}
+// }}}
+
+// UARTSIM::UARTSIM(const char *path)
+// {{{
+UARTSIM::UARTSIM(const char *path) {
+	m_conrd = m_conwr = m_skt = -1;
+	m_path = NULL;
+	setup_listener(path);
+	init();
+}
+// }}}
+
+// UARTSIM::init
+// {{{
+void	UARTSIM::init(void) {
 	setup(25);	// Set us up for (default) 8N1 w/ a baud rate of CLK/25
 	m_rx_baudcounter = 0;
 	m_tx_baudcounter = 0;
@@ -125,8 +222,13 @@ void	UARTSIM::kill(void) {
 	if (m_conrd >= 0)				close(m_conrd);
 	if ((m_conwr >= 0)&&(m_conwr != m_conrd))	close(m_conwr);
 	if (m_skt >= 0) close(m_skt);
+	if (m_path) {
+		unlink(m_path);
+		free(m_path);
+	}
 
 	m_conrd = m_conwr = m_skt = -1;
+	m_path = NULL;
 }
 // }}}
 
@@ -66,6 +66,9 @@ class	UARTSIM	{
 	//	m_conrd is the file descriptor to read from
 	//	m_conwr is the file descriptor to write to
 	int	m_skt, m_conrd, m_conwr;
+	// The path of a Unix domain socket we are listening on, if any, so
+	// that it may be removed again when we're done
+	char	*m_path;
 	//
 	// The m_setup register is the 29'bit control register used within
 	// the core.
@@ -85,6 +88,10 @@ class	UARTSIM	{
 	// setup_listener is an attempt to encapsulate all of the network
 	// related setup stuff.
 	void	setup_listener(const int port);
+	void	setup_listener(const char *path);
+
+	// init() sets up the UART state, common to both constructors
+	void	init(void);
 
 	// Call check_for_new_connections() to see if we can accept a new
 	// network socket connection to our device
@@ -115,10 +122,18 @@ public:
 	UARTSIM(const int port);
 	// }}}
 
+	// UARTSIM(path)
+	// {{{
+	// Listens on a Unix domain socket at path instead.  Local connections
+	// then skip the TCP stack entirely.
+	UARTSIM(const char *path);
+	// }}}
+
 	// kill(void)
 	// {{{
-	// kill() closes any active connection and the socket.  Once killed,
-	// no further output will be sent to the port.
+	// kill() closes any active connection and the socket, removing any
+	// Unix domain socket from the file system.  Once killed, no further
+	// output will be sent to the port.
 	void	kill(void);
 	// }}}
 
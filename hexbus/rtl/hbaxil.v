@@ -9,7 +9,8 @@
 //	8-bit words.
 //
 //	This particular version is modified from hbbus so that it can drive an
-//	AXI-Lite bus.
+//	AXI-Lite bus.  As with hbbus, OPT_BINARY adds support for the binary
+//	form of the protocol, and OPT_RLE for compressed read responses.
 //
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
@@ -46,6 +47,21 @@
 module	hbaxil #(
 		// {{{
 		parameter	C_AXI_ADDR_WIDTH=32,
+		// Log, base two, of the number of commands that may be waiting
+		// on the bus at any one time
+		parameter	LGFIFO=4,
+		// Log, base two, of the number of AXI requests that may be
+		// outstanding at any one time
+		parameter	LGPIPE=3,
+		// Set OPT_BINARY to support the binary protocol.  This
+		// requires a channel that's eight bits clean.
+		parameter [0:0]	OPT_BINARY=1'b1,
+		// Set OPT_RLE to allow runs of identical read responses to be
+		// compressed, see hbrle.  The host must ask for this.
+		parameter [0:0]	OPT_RLE=1'b1,
+		// The number of interrupt lines, up to 29.  With more than
+		// one, the host is told which of them rose, see hbints.
+		parameter	NINTS=1,
 		localparam	DW=32, AW = C_AXI_ADDR_WIDTH-2
 		// }}}
 	) (
@@ -78,7 +94,7 @@ module	hbaxil #(
 		input	wire	[DW-1:0]	M_AXI_RDATA,
 		input	wire	[1:0]		M_AXI_RRESP,
 		//
-		input	wire			i_interrupt,
+		input	wire	[NINTS-1:0]	i_interrupt,
 		output	wire			o_tx_stb,
 		output	wire	[7:0]		o_tx_byte,
 		input	wire			i_tx_busy
@@ -90,25 +106,31 @@ module	hbaxil #(
 	wire		i_clk;
 	assign		i_clk = S_AXI_ACLK;
 
-	wire		w_reset;
+	wire		w_reset, hex_reset, bin_reset, bin_mode;
 	wire		dec_stb;
 	wire	[4:0]	dec_bits;
+	wire		hex_stb, pck_stb;
+	wire	[33:0]	hex_word, pck_word;
 	wire		iw_stb;
 	wire	[33:0]	iw_word;
 	wire		ow_stb;
 	wire	[33:0]	ow_word;
+	wire		rle_busy, rle_stb;
+	wire	[33:0]	rle_word;
 	wire		idl_busy, int_stb;
 	wire	[33:0]	int_word;
-	wire		hb_busy, idl_stb;
+	wire		enc_busy, idl_stb;
 	wire	[33:0]	idl_word;
+	wire		dw_stb, hb_busy;
+	wire	[33:0]	dw_word;
 	wire		hb_stb, hx_busy;
 	wire	[4:0]	hb_bits;
 	wire		hx_stb, nl_busy;
 	wire	[6:0]	hx_byte;
-	// verilator lint_off UNUSED
-	wire		wb_busy;
-	wire		int_busy;
-	// verilator lint_on UNUSED
+	wire		nl_stb;
+	wire	[6:0]	nl_byte;
+	wire		wb_busy, int_busy;
+	wire		fifo_full;
 	// }}}
 
 	//
@@ -121,8 +143,8 @@ module	hbaxil #(
 	dechxi(
 		// {{{
 		.i_clk(i_clk),
-		.i_stb(i_rx_stb), .i_byte(i_rx_byte),
-		.o_dh_stb(dec_stb), .o_reset(w_reset), .o_dh_bits(dec_bits)
+		.i_stb((i_rx_stb)&&(!bin_mode)), .i_byte(i_rx_byte),
+		.o_dh_stb(dec_stb), .o_reset(hex_reset), .o_dh_bits(dec_bits)
 		// }}}
 	);
 
@@ -133,18 +155,55 @@ module	hbaxil #(
 		// {{{
 		.i_clk(i_clk), .i_reset(w_reset),
 		.i_stb(dec_stb), .i_bits(dec_bits),
-		.o_pck_stb(iw_stb), .o_pck_word(iw_word)
+		.o_pck_stb(hex_stb), .o_pck_word(hex_word)
+		// }}}
+	);
+
+	// In binary mode, bytes are decoded into command words here instead
+	generate if (OPT_BINARY)
+	begin : BINARY_DECODER
+		hbbindec
+		decbin(
+			// {{{
+			.i_clk(i_clk), .i_reset(w_reset),
+			.i_stb(i_rx_stb), .i_byte(i_rx_byte),
+			.o_binary(bin_mode), .o_reset(bin_reset),
+			.i_hex_stb(hex_stb), .i_hex_word(hex_word),
+			.o_pck_stb(pck_stb), .o_pck_word(pck_word)
+			// }}}
+		);
+	end else begin : NO_BINARY_DECODER
+		assign	bin_mode  = 1'b0;
+		assign	bin_reset = 1'b0;
+		assign	pck_stb   = hex_stb;
+		assign	pck_word  = hex_word;
+	end endgenerate
+
+	assign	w_reset = (hex_reset)||(bin_reset);
+
+	// Commands wait here until the bus and the return channel are both
+	// ready for them.  The host never sends more than the FIFO holds, but
+	// should it, anything arriving while the FIFO is full is lost, and
+	// hbidle reports it with a bus error.
+	hbfifo	#(.LGFLEN(LGFIFO))
+	cmdfifo(
+		// {{{
+		.i_clk(i_clk), .i_reset(w_reset),
+		.i_stb(pck_stb), .i_word(pck_word), .o_full(fifo_full),
+		.o_stb(iw_stb), .o_word(iw_word), .i_busy(wb_busy)
 		// }}}
 	);
 
 	//
 	// We'll use these bus command words to drive a wishbone bus
 	//
-	hbexecaxi #(AW)
+	hbexecaxi #(.ADDRESS_WIDTH(AW), .LGFIFO(LGFIFO), .LGPIPE(LGPIPE),
+		.OPT_BINARY(OPT_BINARY), .OPT_RLE(OPT_RLE))
 	axilexec(
 		// {{{
 		.i_clk(i_clk), .i_reset(w_reset),
 		.i_cmd_stb(iw_stb), .i_cmd_word(iw_word), .o_cmd_busy(wb_busy),
+		.i_rsp_busy(rle_busy),
 		.o_rsp_stb(ow_stb), .o_rsp_word(ow_word),
 		//
 		.M_AXI_AWVALID(M_AXI_AWVALID),
@@ -173,14 +232,32 @@ module	hbaxil #(
 		// }}}
 	);
 
+	// Runs of identical read responses may be compressed here, once the
+	// host asks for it
+	generate if (OPT_RLE)
+	begin : RLE_COMPRESSION
+		hbrle
+		rle(
+			// {{{
+			.i_clk(i_clk), .i_reset(w_reset),
+			.i_stb(ow_stb), .i_word(ow_word), .o_busy(rle_busy),
+			.o_stb(rle_stb), .o_word(rle_word), .i_busy(int_busy)
+			// }}}
+		);
+	end else begin : NO_RLE_COMPRESSION
+		assign	rle_stb  = ow_stb;
+		assign	rle_word = ow_word;
+		assign	rle_busy = int_busy;
+	end endgenerate
+
 	// We'll then take the responses from the bus, and add an interrupt
 	// flag to the output any time things are idle.  This also acts
 	// as a one-stage FIFO
-	hbints
+	hbints #(.NINTS(NINTS))
 	addints(
 		// {{{
 		.i_clk(i_clk), .i_reset(w_reset), .i_interrupt(i_interrupt),
-		.i_stb(ow_stb), .i_word(ow_word), .o_int_busy(int_busy),
+		.i_stb(rle_stb), .i_word(rle_word), .o_int_busy(int_busy),
 			.o_int_stb(int_stb), .o_int_word(int_word),
 			.i_busy(idl_busy)
 		// }}}
@@ -193,20 +270,47 @@ module	hbaxil #(
 	addidles(
 		// {{{
 		.i_clk(i_clk), .i_reset(w_reset),
+		.i_lost((pck_stb)&&(fifo_full)),
 		.i_cmd_stb(int_stb), .i_cmd_word(int_word),
 			.o_idl_busy(idl_busy),
 		.o_idl_stb(idl_stb), .o_idl_word(idl_word),
-			.i_busy(hb_busy)
+			.i_busy(enc_busy)
 		// }}}
 	);
 
+	// In binary mode, responses are encoded into bytes here.  Otherwise,
+	// they continue down the hexadecimal chain below.
+	generate if (OPT_BINARY)
+	begin : BINARY_ENCODER
+		hbbinenc
+		encbin(
+			// {{{
+			.i_clk(i_clk), .i_reset(w_reset),
+			.i_stb(idl_stb), .i_word(idl_word), .o_busy(enc_busy),
+			.o_hex_stb(dw_stb), .o_hex_word(dw_word),
+				.i_hex_busy(hb_busy),
+				.i_hex_idle((!hb_stb)&&(!hx_stb)&&(!nl_stb)),
+			.i_nl_stb(nl_stb), .i_nl_byte(nl_byte),
+			.o_tx_stb(o_tx_stb), .o_tx_byte(o_tx_byte),
+				.i_tx_busy(i_tx_busy)
+			// }}}
+		);
+	end else begin : NO_BINARY_ENCODER
+		assign	dw_stb   = idl_stb;
+		assign	dw_word  = idl_word;
+		assign	enc_busy = hb_busy;
+
+		assign	o_tx_stb  = nl_stb;
+		assign	o_tx_byte = { 1'b0, nl_byte };
+	end endgenerate
+
 	// We'll then take that ouput from that stage, and disassemble the
 	// response word into smaller (5-bit) sized units ...
 	hbdeword
 	unpackx(
 		// {{{
 		.i_clk(i_clk), .i_reset(w_reset),
-		.i_stb(idl_stb), .i_word(idl_word), .o_dw_busy(hb_busy),
+		.i_stb(dw_stb), .i_word(dw_word), .o_dw_busy(hb_busy),
 		.o_dw_stb(hb_stb), .o_dw_bits(hb_bits), .i_tx_busy(hx_busy)
 		// }}}
 	);
@@ -230,11 +334,9 @@ module	hbaxil #(
 		.i_clk(i_clk), .i_reset(w_reset),
 		.i_stb(hx_stb), .i_byte(hx_byte),
 		.o_nl_busy(nl_busy),
-		.o_nl_stb(o_tx_stb), .o_nl_byte(o_tx_byte[6:0]),
+		.o_nl_stb(nl_stb), .o_nl_byte(nl_byte),
 			.i_busy(i_tx_busy)
 		// }}}
 	);
 
-	assign	o_tx_byte[7] = 1'b0;
-
 endmodule
@@ -0,0 +1,260 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	hbbindec.v
+// {{{
+// Project:	dbgbus, a collection of 8b channel to WB bus debugging protocols
+//
+// Purpose:	Decodes the binary form of the hexbus protocol.  Where the
+//		hexadecimal protocol spends one character on every four bits,
+//	the binary protocol sends eight bits per byte, so that a host may move
+//	twice as much data across the same link.  The hexadecimal protocol
+//	remains, so that a human at a terminal can still talk to the bus.  This
+//	decoder starts in hexadecimal mode, and only switches to binary once the
+//	host asks it to.
+//
+//	In hexadecimal mode, command words come from hbdechex and hbpack, and
+//	are passed through unchanged.  A mode switch command, 'S' with a special
+//	command of 4'h2 and an argument of one ("S12"), switches the decoder to
+//	binary as it passes.  Bytes are then decoded here instead, as a series
+//	of frames.  Each frame starts with a header byte:
+//
+//	8'b100x_xxxx	Read, no payload
+//	8'b101n_nnnn	Write, followed by (n+1) 32-bit words, most significant
+//			byte first.  Each word is a separate write command.
+//	8'b1100_0nnn	Address, followed by n bytes (n <= 4) of address, most
+//			significant byte first.  Any missing upper bytes are
+//			zero, just as any missing digits are in hexadecimal.
+//	8'b1110_0nnn	Special, followed by n bytes (n <= 4), as with Address
+//
+//	Outside of a frame, anything else is ignored--save for a 'T', which
+//	resets the bus just as it does in hexadecimal mode.  A mode switch
+//	command with an argument of zero, 8'he1 8'h02, returns the decoder to
+//	hexadecimal mode.
+//
+//	The binary protocol needs all eight bits of every byte, so this may
+//	only be used on an eight bit clean channel.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2017-2024, Gisselquist Technology, LLC
+// {{{
+// This file is part of the hexbus debugging interface.
+//
+// The hexbus interface is free software (firmware): you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// The hexbus interface is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  (It's in the $(ROOT)/doc directory.  Run make
+// with no target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	LGPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/lgpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+`default_nettype	none
+// }}}
+module	hbbindec (
+		// {{{
+		input	wire		i_clk, i_reset,
+		// Incoming bytes
+		input	wire		i_stb,
+		input	wire	[7:0]	i_byte,
+		// o_binary is true while we are in binary mode.  hbdechex
+		// should ignore any bytes arriving while it is set.
+		output	reg		o_binary,
+		output	reg		o_reset,
+		// Command words from hbpack, when in hexadecimal mode
+		input	wire		i_hex_stb,
+		input	wire	[33:0]	i_hex_word,
+		// Command words, from either mode
+		output	wire		o_pck_stb,
+		output	wire	[33:0]	o_pck_word
+		// }}}
+	);
+
+	// Local declarations
+	// {{{
+	localparam [1:0]	CMD_SUB_RD	= 2'b00,
+				CMD_SUB_WR	= 2'b01,
+				CMD_SUB_SPECIAL	= 2'b11;
+	localparam [3:0]	SPC_MODE	= 4'h2;
+
+	// r_nbytes counts the bytes remaining in the current word of a frame,
+	// and r_nwords the words remaining in the frame after this one.  A
+	// frame boundary is any time r_nbytes is zero.
+	reg	[1:0]	r_cmd;
+	reg	[2:0]	r_nbytes;
+	reg	[4:0]	r_nwords;
+	reg	[23:0]	r_word;
+	reg		bin_stb;
+	reg	[33:0]	bin_word;
+	wire		w_header, w_valid;
+	// }}}
+
+	// A header byte, and whether it describes a valid frame
+	assign	w_header = (i_stb)&&(o_binary)&&(r_nbytes == 0)&&(i_byte[7]);
+	assign	w_valid  = (!i_byte[6])
+			||((i_byte[4:3] == 2'b00)&&(i_byte[2:0] <= 3'h4));
+
+	// r_cmd, r_nbytes, r_nwords, r_word
+	// {{{
+	initial	r_nbytes = 0;
+	initial	r_nwords = 0;
+	always @(posedge i_clk)
+	if ((i_reset)||(!o_binary))
+	begin
+		r_nbytes <= 0;
+		r_nwords <= 0;
+		r_word   <= 0;
+	end else if (i_stb)
+	begin
+		if (r_nbytes == 0)
+		begin
+			// Start a new frame
+			r_cmd  <= i_byte[6:5];
+			r_word <= 0;
+			if ((i_byte[7])&&(w_valid))
+			begin
+				if (i_byte[6:5] == CMD_SUB_RD)
+				begin
+					r_nbytes <= 0;
+					r_nwords <= 0;
+				end else if (i_byte[6:5] == CMD_SUB_WR)
+				begin
+					r_nbytes <= 3'h4;
+					r_nwords <= i_byte[4:0];
+				end else begin
+					r_nbytes <= i_byte[2:0];
+					r_nwords <= 0;
+				end
+			end
+		end else begin
+			// Shift a byte of payload into the word
+			r_word   <= { r_word[15:0], i_byte };
+			r_nbytes <= r_nbytes - 1'b1;
+			if ((r_nbytes == 1)&&(r_nwords != 0))
+			begin
+				// On to the next word of a write frame
+				r_nbytes <= 3'h4;
+				r_nwords <= r_nwords - 1'b1;
+				r_word   <= 0;
+			end
+		end
+	end
+	// }}}
+
+	// bin_stb, bin_word
+	// {{{
+	// A word is complete with the last byte of its payload, or with its
+	// header if it has no payload.
+	initial	bin_stb = 1'b0;
+	always @(posedge i_clk)
+	if ((i_reset)||(!o_binary))
+		bin_stb <= 1'b0;
+	else if (w_header)
+		bin_stb <= (w_valid)&&((i_byte[6:5] == CMD_SUB_RD)
+				||((i_byte[6])&&(i_byte[2:0] == 0)));
+	else
+		bin_stb <= (i_stb)&&(r_nbytes == 1);
+
+	always @(posedge i_clk)
+	if (r_nbytes == 0)
+		bin_word <= { i_byte[6:5], 32'h0 };
+	else
+		bin_word <= { r_cmd, r_word, i_byte };
+	// }}}
+
+	// o_reset
+	// {{{
+	// A 'T' between frames resets everything, as it does in hexadecimal
+	initial	o_reset = 1'b0;
+	always @(posedge i_clk)
+		o_reset <= (i_stb)&&(o_binary)&&(r_nbytes == 0)
+				&&(i_byte == 8'h54);
+	// }}}
+
+	// o_binary
+	// {{{
+	// The mode changes as the mode switch command leaves.  Every command
+	// following it, starting with the very next byte, is then decoded in
+	// the new mode.
+	initial	o_binary = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+		o_binary <= 1'b0;
+	else if ((o_pck_stb)&&(o_pck_word[33:32] == CMD_SUB_SPECIAL)
+			&&(o_pck_word[3:0] == SPC_MODE))
+		o_binary <= o_pck_word[4];
+	// }}}
+
+	assign	o_pck_stb  = (o_binary) ? bin_stb  : i_hex_stb;
+	assign	o_pck_word = (o_binary) ? bin_word : i_hex_word;
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//
+// Formal properties
+// {{{
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+`ifdef	FORMAL
+`ifdef	HBBINDEC
+`define	ASSUME	assume
+`define	ASSERT	assert
+`else
+`define	ASSUME	assert
+`define	ASSERT	assert
+`endif
+	reg	f_past_valid;
+
+	initial	f_past_valid = 1'b0;
+	always @(posedge i_clk)
+		f_past_valid <= 1'b1;
+
+	always @(*)
+	if (!f_past_valid)
+		`ASSUME(i_reset);
+
+	// Bytes arrive from a serial port, never on two clocks in a row
+	always @(posedge i_clk)
+	if ((f_past_valid)&&($past(i_stb)))
+		`ASSUME(!i_stb);
+
+	always @(*)
+	begin
+		`ASSERT(r_nbytes <= 3'h4);
+		if (r_nbytes == 0)
+			`ASSERT(r_nwords == 0);
+		if (r_nwords != 0)
+			`ASSERT(r_cmd == CMD_SUB_WR);
+		if (!o_binary)
+			`ASSERT((r_nbytes == 0)&&(!bin_stb));
+	end
+
+	// Only writes, addresses, and special commands have payloads
+	always @(*)
+	if (r_nbytes != 0)
+		`ASSERT(r_cmd != CMD_SUB_RD);
+
+	// A read header produces a read command
+	always @(posedge i_clk)
+	if ((f_past_valid)&&(!$past(i_reset))&&($past(w_header))
+			&&($past(i_byte[6:5]) == CMD_SUB_RD)&&(o_binary))
+		`ASSERT((o_pck_stb)&&(o_pck_word == { CMD_SUB_RD, 32'h0 }));
+`endif
+// }}}
+endmodule
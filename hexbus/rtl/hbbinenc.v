@@ -0,0 +1,290 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	hbbinenc.v
+// {{{
+// Project:	dbgbus, a collection of 8b channel to WB bus debugging protocols
+//
+// Purpose:	Encodes response words for the binary form of the hexbus
+//		protocol (see hbbindec).  This sits between hbidle and hbdeword.
+//	In hexadecimal mode, words are passed on down the hexadecimal chain,
+//	hbdeword, hbgenhex, and hbnewline.  In binary mode, words are instead
+//	encoded here, eight bits per byte.
+//
+//	The mode changes as the response to the mode switch command passes
+//	through.  This response is itself sent in the old mode, so the host
+//	knows exactly where the new mode starts.  Words following it wait until
+//	everything sent in the old mode has been sent, so the two modes never
+//	mix.
+//
+//	In binary mode, every response starts with an escape character, 8'h1b,
+//	followed by a letter saying what it is--the same letters as are used in
+//	hexadecimal mode:
+//
+//	ESC R	Read data.  Each read response is then four bytes of data, most
+//		significant byte first.  Further read responses follow with no
+//		further header, until the next escape.
+//	ESC A	Address, followed by four bytes
+//	ESC K	Write acknowledgement
+//	ESC T	Reset.  Since any reset also returns the bus to hexadecimal
+//		mode, this is normally sent as a hexadecimal 'T' instead.
+//	ESC E	Bus error
+//	ESC I	Interrupt
+//	ESC Z	Idle
+//	ESC M	Mode switch, back to hexadecimal
+//	ESC D	Repeat the last read response, followed by four bytes of count.
+//		See hbrle.
+//	ESC V	Interrupt vector, followed by four bytes naming the interrupt
+//		lines that have risen.  See hbints.
+//
+//	Any data byte that happens to be an escape is sent twice.  A long run of
+//	reads, therefore, costs a little over four bytes per word, rather than
+//	the nine characters it would cost in hexadecimal.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2017-2024, Gisselquist Technology, LLC
+// {{{
+// This file is part of the hexbus debugging interface.
+//
+// The hexbus interface is free software (firmware): you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// The hexbus interface is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  (It's in the $(ROOT)/doc directory.  Run make
+// with no target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	LGPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/lgpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+`default_nettype	none
+// }}}
+module	hbbinenc (
+		// {{{
+		input	wire		i_clk, i_reset,
+		// Response words, from hbidle
+		input	wire		i_stb,
+		input	wire	[33:0]	i_word,
+		output	wire		o_busy,
+		// Response words for the hexadecimal chain, to hbdeword
+		output	wire		o_hex_stb,
+		output	wire	[33:0]	o_hex_word,
+		input	wire		i_hex_busy,
+		// i_hex_idle should be true once the hexadecimal chain has
+		// nothing left to send
+		input	wire		i_hex_idle,
+		// Characters from the end of the hexadecimal chain, hbnewline
+		input	wire		i_nl_stb,
+		input	wire	[6:0]	i_nl_byte,
+		// The outgoing byte stream
+		output	wire		o_tx_stb,
+		output	wire	[7:0]	o_tx_byte,
+		input	wire		i_tx_busy
+		// }}}
+	);
+
+	// Local declarations
+	// {{{
+	localparam [7:0]	ESC = 8'h1b;
+	localparam [1:0]	RSP_SUB_DATA	= 2'b00,
+				RSP_SUB_ACK	= 2'b01,
+				RSP_SUB_ADDR	= 2'b10;
+	localparam [4:0]	RSP_MODE = 5'b11100;
+
+	reg		r_binary, r_inrun, r_esc, r_code, r_dup;
+	reg	[7:0]	r_letter;
+	reg	[2:0]	r_nbytes;
+	reg	[31:0]	r_data;
+	reg		bin_stb;
+	reg	[7:0]	bin_byte;
+	wire		bin_idle, bin_accept, bin_step, w_mode;
+	// }}}
+
+	// bin_idle is true once every byte of the last word has been handed
+	// off to the output register.  bin_step is true when the output
+	// register can take another byte.
+	assign	bin_idle   = (!r_esc)&&(!r_code)&&(!r_dup)&&(r_nbytes == 0);
+	assign	bin_step   = (!bin_stb)||(!i_tx_busy);
+	assign	bin_accept = (i_stb)&&(!o_busy)&&(r_binary);
+	assign	w_mode     = (i_stb)&&(!o_busy)&&(i_word[33:29] == RSP_MODE);
+
+	// Words go to the hexadecimal chain only once every binary byte has
+	// gone out, and are only encoded here once every hexadecimal character
+	// has gone out.
+	assign	o_busy = (r_binary) ? ((!bin_idle)||(!i_hex_idle))
+				: ((i_hex_busy)||(!bin_idle)||(bin_stb));
+	assign	o_hex_stb  = (i_stb)&&(!r_binary)&&(bin_idle)&&(!bin_stb);
+	assign	o_hex_word = i_word;
+
+	// r_binary
+	// {{{
+	initial	r_binary = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+		r_binary <= 1'b0;
+	else if (w_mode)
+		r_binary <= i_word[0];
+	// }}}
+
+	// r_inrun, r_esc, r_code, r_letter, r_nbytes, r_data, r_dup
+	// {{{
+	// A new word loads a header (r_esc, r_code), and any data bytes.  Each
+	// is then handed to the output register in turn, one per byte time.
+	initial	r_inrun  = 1'b0;
+	initial	r_esc    = 1'b0;
+	initial	r_code   = 1'b0;
+	initial	r_dup    = 1'b0;
+	initial	r_nbytes = 0;
+	always @(posedge i_clk)
+	if (i_reset)
+	begin
+		r_inrun  <= 1'b0;
+		r_esc    <= 1'b0;
+		r_code   <= 1'b0;
+		r_dup    <= 1'b0;
+		r_nbytes <= 0;
+	end else if (bin_accept)
+	begin
+		// Only read data continues a run, everything else ends it
+		r_inrun  <= (i_word[33:32] == RSP_SUB_DATA);
+		r_esc    <= 1'b1;
+		r_code   <= 1'b1;
+		r_nbytes <= 0;
+		// The top bits of a special word are its code, not its data
+		r_data   <= { (i_word[33:32] == 2'b11) ? 3'h0 : i_word[31:29],
+				i_word[28:0] };
+		case(i_word[33:32])
+		RSP_SUB_DATA: begin
+			r_letter <= "R";
+			r_esc    <= !r_inrun;
+			r_code   <= !r_inrun;
+			r_nbytes <= 3'h4;
+			end
+		RSP_SUB_ACK:	r_letter <= "K";
+		RSP_SUB_ADDR: begin
+			r_letter <= "A";
+			r_nbytes <= 3'h4;
+			end
+		default: case(i_word[31:29])
+			3'h0:	r_letter <= "T";
+			3'h1:	r_letter <= "E";
+			3'h2:	r_letter <= "I";
+			3'h3:	r_letter <= "Z";
+			3'h4:	r_letter <= "M";
+			3'h5: begin
+				r_letter <= "D";
+				r_nbytes <= 3'h4;
+				end
+			3'h6: begin
+				r_letter <= "V";
+				r_nbytes <= 3'h4;
+				end
+			default: begin
+				// Anything else is dropped
+				r_esc  <= 1'b0;
+				r_code <= 1'b0;
+				end
+			endcase
+		endcase
+	end else if (bin_step)
+	begin
+		if (r_esc)
+			r_esc <= 1'b0;
+		else if (r_code)
+			r_code <= 1'b0;
+		else if (r_dup)
+			r_dup <= 1'b0;
+		else if (r_nbytes != 0)
+		begin
+			r_data   <= { r_data[23:0], 8'h0 };
+			r_nbytes <= r_nbytes - 1'b1;
+			r_dup    <= (r_data[31:24] == ESC);
+		end
+	end
+	// }}}
+
+	// bin_stb, bin_byte
+	// {{{
+	initial	bin_stb = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+		bin_stb <= 1'b0;
+	else if (bin_step)
+		bin_stb <= (!bin_accept)&&(!bin_idle);
+
+	always @(posedge i_clk)
+	if (bin_step)
+	begin
+		if ((r_esc)||((!r_code)&&(r_dup)))
+			bin_byte <= ESC;
+		else if (r_code)
+			bin_byte <= r_letter;
+		else
+			bin_byte <= r_data[31:24];
+	end
+	// }}}
+
+	// Only one of the two chains is ever active at a time
+	assign	o_tx_stb  = (bin_stb)||(i_nl_stb);
+	assign	o_tx_byte = (bin_stb) ? bin_byte : { 1'b0, i_nl_byte };
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//
+// Formal properties
+// {{{
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+`ifdef	FORMAL
+`ifdef	HBBINENC
+`define	ASSUME	assume
+`define	ASSERT	assert
+`else
+`define	ASSUME	assert
+`define	ASSERT	assert
+`endif
+	reg	f_past_valid;
+
+	initial	f_past_valid = 1'b0;
+	always @(posedge i_clk)
+		f_past_valid <= 1'b1;
+
+	always @(*)
+	if (!f_past_valid)
+		`ASSUME(i_reset);
+
+	// Once offered, a word stays offered until it is taken
+	always @(posedge i_clk)
+	if ((f_past_valid)&&(!$past(i_reset))&&($past(i_stb))&&($past(o_busy)))
+		`ASSUME((i_stb)&&($stable(i_word)));
+
+	// Nothing goes down the hexadecimal chain while binary bytes remain
+	always @(*)
+	if ((!bin_idle)||(bin_stb))
+		`ASSERT(!o_hex_stb);
+
+	always @(*)
+		`ASSERT(r_nbytes <= 3'h4);
+
+	// Once offered, a byte stays offered until it is taken
+	always @(posedge i_clk)
+	if ((f_past_valid)&&(!$past(i_reset))&&($past(bin_stb))
+			&&($past(i_tx_busy)))
+		`ASSERT((bin_stb)&&($stable(bin_byte)));
+`endif
+// }}}
+endmodule
@@ -46,6 +46,12 @@
 module	hbconsole #(
 		// {{{
 		parameter	AW = 30,
+		// Log, base two, of the number of commands that may be waiting
+		// on the bus at any one time
+		parameter	LGFIFO = 4,
+		// Log, base two, of the number of bus requests that may be
+		// outstanding at any one time
+		parameter	LGPIPE = 3,
 		localparam	DW = 32
 		// }}}
 	) (
@@ -81,16 +87,13 @@ module	hbconsole #(
 	wire		w_reset;
 	wire		dec_stb;
 	wire	[4:0]	dec_bits;
-	wire		iw_stb;
-	wire	[33:0]	iw_word;
-	// verilator lint_off UNUSED
+	wire		pck_stb, iw_stb;
+	wire	[33:0]	pck_word, iw_word;
 	wire		wb_busy;
-	// verilator lint_on UNUSED
+	wire		fifo_full;
 	wire		ow_stb;
 	wire	[33:0]	ow_word;
-	// verilator lint_off UNUSED
 	wire		int_busy;
-	// verilator lint_on UNUSED
 	wire		idl_busy, int_stb;
 	wire	[33:0]	int_word;
 	wire		hb_busy, idl_stb;
@@ -132,18 +135,32 @@ module	hbconsole #(
 		// {{{
 		.i_clk(i_clk), .i_reset(w_reset),
 		.i_stb(dec_stb), .i_bits(dec_bits),
-		.o_pck_stb(iw_stb), .o_pck_word(iw_word)
+		.o_pck_stb(pck_stb), .o_pck_word(pck_word)
+		// }}}
+	);
+
+	// Commands wait here until the bus and the return channel are both
+	// ready for them.  The host never sends more than the FIFO holds, but
+	// should it, anything arriving while the FIFO is full is lost, and
+	// hbidle reports it with a bus error.
+	hbfifo	#(.LGFLEN(LGFIFO))
+	cmdfifo(
+		// {{{
+		.i_clk(i_clk), .i_reset(w_reset),
+		.i_stb(pck_stb), .i_word(pck_word), .o_full(fifo_full),
+		.o_stb(iw_stb), .o_word(iw_word), .i_busy(wb_busy)
 		// }}}
 	);
 
 	//
 	// We'll use these bus command words to drive a wishbone bus
 	//
-	hbexec #(AW)
+	hbexec	#(.ADDRESS_WIDTH(AW), .LGFIFO(LGFIFO), .LGPIPE(LGPIPE))
 	wbexec(
 		// {{{
 		.i_clk(i_clk), .i_reset(w_reset),
 		.i_cmd_stb(iw_stb), .i_cmd_word(iw_word), .o_cmd_busy(wb_busy),
+		.i_rsp_busy(int_busy),
 		.o_rsp_stb(ow_stb), .o_rsp_word(ow_word),
 		.o_wb_cyc(o_wb_cyc), .o_wb_stb(o_wb_stb),
 			.o_wb_we(o_wb_we), .o_wb_addr(o_wb_addr),
@@ -172,6 +189,7 @@ module	hbconsole #(
 	addidles(
 		// {{{
 		.i_clk(i_clk), .i_reset(w_reset),
+			.i_lost((pck_stb)&&(fifo_full)),
 			.i_cmd_stb(int_stb), .i_cmd_word(int_word),
 				.o_idl_busy(idl_busy),
 			.o_idl_stb(idl_stb), .o_idl_word(idl_word),
@@ -254,10 +272,6 @@ module	hbconsole #(
 	always @(posedge i_clk)
 		f_past_valid <= 1'b1;
 
-	always @(*)
-	if (int_busy)
-		assume(!ow_stb);
-
 	always @(posedge i_clk)
 	if ((f_past_valid)&&(!$past(w_reset)))
 	begin
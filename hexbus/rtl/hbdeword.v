@@ -9,6 +9,10 @@
 //	five bit word is an out of band bit, indicating that the top two
 //	command bits of the interface have changed.
 //
+//	Special words carry no data, save for the repeat count from hbrle,
+//	5'h1d, and the interrupt vector from hbints, 5'h1e.  Each of these is
+//	followed by all eight of its hexadecimal digits.
+//
 //
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
@@ -56,6 +60,9 @@ module	hbdeword(
 		// }}}
 	);
 
+	localparam [4:0]	RSP_REPEAT = 5'h1d,
+				RSP_INTVEC = 5'h1e;
+
 	reg	[3:0]	r_len;
 	reg	[31:0]	r_word;
 
@@ -70,7 +77,10 @@ module	hbdeword(
 	end else if ((i_stb)&&(!o_dw_busy))
 	begin
 		o_dw_stb <= 1'b1;
-		if (i_word[33:32] == 2'b11)
+		if ((i_word[33:29] == RSP_REPEAT)
+				||(i_word[33:29] == RSP_INTVEC))
+			r_len <= 4'h8;
+		else if (i_word[33:32] == 2'b11)
 			r_len <= 4'h0;
 		else
 			r_len <= 4'h8;
@@ -84,7 +94,9 @@ module	hbdeword(
 	always @(posedge i_clk)
 	// No reset logic needed
 	if ((i_stb)&&(!o_dw_busy))
-		r_word <= i_word[31:0];
+		// The top bits of a special word are its code, not its data
+		r_word <= { (i_word[33:32] == 2'b11) ? 3'h0 : i_word[31:29],
+				i_word[28:0] };
 	else if (!i_tx_busy)
 		// Whenever we aren't busy, a new nibble is accepted
 		// and the word shifts.  If we never set our output
@@ -15,11 +15,64 @@
 //		bit[1] is an address difference bit
 //		bit[0] is an increment bit
 //	2'b11	Special command
+//		Bits [3:0] select the command, bits [31:4] are its argument
+//		4'h0	Capability query.  Returns a data word describing
+//			what this core supports (CAPABILITIES below)
+//		4'h1	Burst read.  Reads the argument's number of words,
+//			starting at the current address, returning one data
+//			word for each.  No further commands are accepted until
+//			the burst completes, or until a bus error ends it early.
+//		4'h2	Mode switch, if OPT_BINARY or OPT_RLE is set.  Bit [4]
+//			of the argument selects the binary protocol (1) or the
+//			hexadecimal one (0), and bit [5] turns read response
+//			compression (hbrle) on or off.  This is answered with
+//			a mode response carrying the mode selected, which the
+//			response chain (hbrle, hbbinenc) uses to change its
+//			own mode, whereas the decoder (hbbindec) has already
+//			switched by the time this command arrives.
+//		4'h3	Byte enables.  Bits [7:4] of the argument become the
+//			byte select lines (o_wb_sel) of the next write only.
+//			Every other write, and every read, selects all four
+//			bytes.  No response is returned.
+//		4'h4	Poll.  The next two read or write commands aren't
+//			issued, but rather their (write) values are taken as a
+//			mask and then an expected value.  The current address
+//			is then read, over and over, until its value ANDed with
+//			the mask matches the expected value, or until the
+//			argument's number of clocks have passed.  Only the last
+//			value read is returned.  The address isn't incremented.
+//		4'h5	CRC.  Reads the argument's number of words, as with a
+//			burst read, but rather than returning them, returns
+//			only their CRC32 (see crc32_word below).  A bus error
+//			ends the CRC, and is returned in place of it.
+//		4'h6	Fill.  The next read or write command supplies a value,
+//			which is then written to the argument's number of
+//			words, starting at the current address.
+//		4'h7	Copy.  The next read or write command supplies a source
+//			(byte) address.  The argument's number of words are
+//			then copied from there to the current address, one
+//			word at a time.  Both addresses are incremented, or
+//			not, as the current address is.
+//			Fills and copies are answered with a single write
+//			acknowledgement once complete, or a bus error should
+//			any of their requests fail.
+//		Any other special command is ignored.
 //
-//	In the interests of code simplicity, this memory operator is 
-//	susceptible to unknown results should a new command be sent to it
-//	before it completes the last one.  Unpredictable results might then
-//	occurr.
+//	The bus is pipelined.  Up to 2^LGPIPE requests may be outstanding at
+//	any time, so back to back reads or writes--and burst reads in
+//	particular--may issue one request per clock.  Responses are returned
+//	in order through a small FIFO, 2^LGPIPE words deep, and no request is
+//	ever issued unless there is room in that FIFO for its response.  The
+//	return channel may then stall this FIFO (i_rsp_busy) as it needs to.
+//
+//	Reads and writes may only join a bus cycle going the same direction.
+//	Address and special commands wait for the bus to be idle, so that their
+//	responses are returned in order with everything else.
+//
+//	A bus error aborts the bus cycle.  Every read or write command still
+//	outstanding at the time is answered with a bus error, so that every
+//	command receives one response.  A burst read, however, is answered with
+//	a single bus error.
 //
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
@@ -68,12 +121,50 @@
 `define	RSP_WRITE_ACKNOWLEDGEMENT { `RSP_SUB_ACK, 32'h0 }
 `define	RSP_RESET		{ `RSP_SUB_SPECIAL, 3'h0, 29'h00 }
 `define	RSP_BUS_ERROR		{ `RSP_SUB_SPECIAL, 3'h1, 29'h00 }
+`define	RSP_MODE		{ `RSP_SUB_SPECIAL, 3'h4, 27'h00 }
+//
+`define	SPC_CAPS	4'h0
+`define	SPC_BURST	4'h1
+`define	SPC_MODE	4'h2
+`define	SPC_SEL		4'h3
+`define	SPC_POLL	4'h4
+`define	SPC_CRC		4'h5
+`define	SPC_FILL	4'h6
+`define	SPC_COPY	4'h7
 // }}}
 module	hbexec #(
 		// {{{
 		parameter	ADDRESS_WIDTH=30,
+		// LGFIFO is the log, base two, of the depth of any command
+		// FIFO feeding this core, or zero if there is none.  It isn't
+		// used here, save to report it to the host.
+		parameter [3:0]	LGFIFO = 4'h0,
+		// LGPIPE is the log, base two, of the number of bus requests
+		// that may be outstanding at once.  It must be at least one.
+		parameter [3:0]	LGPIPE = 4'h3,
+		// OPT_BINARY should be set if this core is wrapped with the
+		// binary protocol encoder and decoder, hbbinenc and hbbindec.
+		// It enables the mode switch command.
+		parameter [0:0]	OPT_BINARY = 1'b0,
+		// OPT_RLE should likewise be set if the responses from this
+		// core pass through hbrle, which may compress them.
+		parameter [0:0]	OPT_RLE = 1'b0,
 		localparam	AW=ADDRESS_WIDTH, // Shorthand for address width
-				CW=34	// Command word width
+				CW=34,	// Command word width
+		// CAPABILITIES, returned by the capability query.  Bits [15:0]
+		// are a bitmask of the special commands supported: the
+		// capability query (bit 0), burst reads (bit 1), the mode
+		// switch (bit 2), byte enables (bit 3), polling (bit 4), CRCs
+		// (bit 5), fills (bit 6), and copies (bit 7).  Bits [19:16] are
+		// LGFIFO, and [23:20] LGPIPE.
+		// Bits [25:24] are the modes that may be switched on: binary
+		// (bit 24) and compression (bit 25).  The remaining bits are
+		// reserved.
+		localparam [0:0]	OPT_MODE = (OPT_BINARY)||(OPT_RLE),
+		localparam [31:0]	CAPABILITIES = { 6'h0, OPT_RLE,
+						OPT_BINARY, LGPIPE, LGFIFO,
+						8'h0, 5'h1f, OPT_MODE, 2'b11 },
+		localparam	PIPEDEPTH = (1<<LGPIPE)
 		// }}}
 	) (
 		// {{{
@@ -86,15 +177,16 @@ module	hbexec #(
 		// }}}
 		// The return command channel
 		// {{{
-		output	reg			o_rsp_stb,
-		output	reg	[(CW-1):0]	o_rsp_word,
+		input	wire			i_rsp_busy,
+		output	wire			o_rsp_stb,
+		output	wire	[(CW-1):0]	o_rsp_word,
 		// }}}
 		// Wishbone outputs
 		// {{{
 		output	reg			o_wb_cyc, o_wb_stb, o_wb_we,
 		output	reg	[(AW-1):0]	o_wb_addr,
 		output	reg	[31:0]		o_wb_data,
-		output	wire	[3:0]		o_wb_sel,
+		output	reg	[3:0]		o_wb_sel,
 		// }}}
 		// Wishbone inputs
 		// {{{
@@ -106,17 +198,280 @@ module	hbexec #(
 
 	// Local declarations
 	// {{{
-	reg	newaddr, inc;
-	wire	i_cmd_addr, i_cmd_wr, i_cmd_rd, i_cmd_bus;
+	reg	newaddr, inc, capreq, modereq, rst_pending, argerr;
+	reg	[1:0]	mode;
+	reg	[3:0]	r_sel;
+	wire	i_cmd_addr, i_cmd_wr, i_cmd_rd, i_cmd_bus, i_cmd_special,
+		i_cmd_arg;
+	wire	w_issue, w_credit;
+	reg		burst;
+	reg	[27:0]	burst_count;
+	wire		burst_next;
+	// nargs counts the argument words the special command r_op still
+	// needs.  These are collected into r_args, the most recent at the
+	// bottom.
+	reg	[1:0]	nargs;
+	reg	[3:0]	r_op;
+	reg	[63:0]	r_args;
+	wire		w_args_done, w_arg_abort;
+	reg		poll;
+	reg	[27:0]	poll_timeout;
+	wire		poll_next, poll_hit, poll_miss;
+	// CRCs, fills, and copies (blk) are only answered once complete.  The
+	// responses to their individual requests are dropped, save that a
+	// CRC first folds its reads into crc_reg.  A copy alternates between
+	// reading (!cp_wr) and writing, swapping o_wb_addr with cp_addr
+	// between the two.
+	reg		crc, fill, copy, cp_wr;
+	reg	[31:0]	crc_reg;
+	reg	[(AW-1):0]	cp_addr;
+	wire		blk, blk_drop, blk_done, copy_next;
+	// nout counts requests accepted by the bus, but not yet acknowledged.
+	// ncommit counts every response we've promised but not yet handed to
+	// the return channel: those in flight on the bus, those waiting to go
+	// into the response FIFO, and those already in it.
+	reg	[LGPIPE:0]	nout, ncommit, err_count;
+	wire	[LGPIPE:0]	w_inflight;
+	reg			rsp_push;
+	reg	[(CW-1):0]	rsp_word;
+	wire			rsp_pop, rsp_full;
 	// }}}
 
 	//
 	// Decode our input commands
 	// {{{
+	// Reads and writes are only bus commands if no special command is
+	// waiting on them for its arguments
 	assign	i_cmd_addr = (i_cmd_stb)&&(i_cmd_word[33:32] == `CMD_SUB_ADDR);
-	assign	i_cmd_rd   = (i_cmd_stb)&&(i_cmd_word[33:32] == `CMD_SUB_RD);
-	assign	i_cmd_wr   = (i_cmd_stb)&&(i_cmd_word[33:32] == `CMD_SUB_WR);
-	assign	i_cmd_bus  = (i_cmd_stb)&&(i_cmd_word[33]    == `CMD_SUB_BUS);
+	assign	i_cmd_rd   = (i_cmd_stb)&&(i_cmd_word[33:32] == `CMD_SUB_RD)
+				&&(nargs == 0);
+	assign	i_cmd_wr   = (i_cmd_stb)&&(i_cmd_word[33:32] == `CMD_SUB_WR)
+				&&(nargs == 0);
+	assign	i_cmd_bus  = (i_cmd_stb)&&(i_cmd_word[33]    == `CMD_SUB_BUS)
+				&&(nargs == 0);
+	assign	i_cmd_arg  = (i_cmd_stb)&&(i_cmd_word[33]    == `CMD_SUB_BUS)
+				&&(nargs != 0);
+	assign	i_cmd_special=(i_cmd_stb)&&(i_cmd_word[33:32]== `CMD_SUB_SPECIAL);
+	// }}}
+
+	// o_cmd_busy
+	// {{{
+	// We can only accept a command if we have room for its response.
+	// Reads and writes may join a bus cycle in progress, but only if going
+	// the same direction, and only once the last request has been (or is
+	// being) accepted.  Anything else must wait for the bus to be idle.
+	// An address or special arriving while a special is still waiting on
+	// its arguments waits as well, while that special is aborted.
+	assign	w_credit = (ncommit < PIPEDEPTH);
+	assign	o_cmd_busy = (burst)||(poll)||(copy)||(rst_pending)
+			||(err_count != 0)||(newaddr)||(capreq)||(modereq)
+			||(argerr)||((i_cmd_word[33])&&(nargs != 0))
+			||((o_wb_stb)&&(i_wb_stall))
+			||(!w_credit)
+			||((o_wb_cyc)&&((i_wb_err)
+				||(i_cmd_word[33] != `CMD_SUB_BUS)
+				||(i_cmd_word[32] != o_wb_we)));
+
+	// w_issue: start a new bus request on the next clock
+	assign	w_issue = ((i_cmd_bus)&&(!o_cmd_busy))||(burst_next)||(poll_next)
+			||(copy_next);
+	// }}}
+
+	// burst, burst_count
+	// {{{
+	// A burst read is a series of reads, issued as fast as the bus and
+	// the response FIFO allow.  We remain in the burst until its last
+	// read has been acknowledged.  A CRC, even of no words at all, also
+	// remains in the burst until then, so that its answer follows.  So
+	// does a fill, which is a burst of writes.
+	initial	burst = 1'b0;
+	always @(posedge i_clk)
+	if ((i_reset)||((i_wb_err)&&(o_wb_cyc)))
+		burst <= 1'b0;
+	else if ((i_cmd_special)&&(!o_cmd_busy)
+			&&(i_cmd_word[3:0] == `SPC_BURST))
+		burst <= (i_cmd_word[31:4] != 0);
+	else if ((i_cmd_special)&&(!o_cmd_busy)
+			&&(i_cmd_word[3:0] == `SPC_CRC))
+		burst <= 1'b1;
+	else if ((w_args_done)&&(r_op == `SPC_FILL))
+		burst <= 1'b1;
+	else if ((burst_count == 0)&&(!o_wb_cyc))
+		burst <= 1'b0;
+
+	initial	burst_count = 0;
+	always @(posedge i_clk)
+	if ((i_reset)||((i_wb_err)&&(o_wb_cyc)))
+		burst_count <= 0;
+	else if ((i_cmd_special)&&(!o_cmd_busy)
+			&&((i_cmd_word[3:0] == `SPC_BURST)
+				||(i_cmd_word[3:0] == `SPC_CRC)
+				||(i_cmd_word[3:0] == `SPC_FILL)
+				||(i_cmd_word[3:0] == `SPC_COPY)))
+		burst_count <= i_cmd_word[31:4];
+	else if ((burst_next)||((copy_next)&&(!cp_wr)))
+		burst_count <= burst_count - 1;
+
+	assign	burst_next = (burst)&&(burst_count != 0)&&(w_credit)
+			&&((!o_wb_stb)||(!i_wb_stall))
+			&&((!o_wb_cyc)||(!i_wb_err));
+	// }}}
+
+	// crc, crc_reg
+	// {{{
+	// The CRC is the common (IEEE 802.3) CRC32: reflected, with the
+	// polynomial 0xedb88320, starting from all ones, and complemented at
+	// the end.  Each word is taken a byte at a time, from its most
+	// significant byte to its least.  A whole word is folded in per clock.
+	function [31:0]	crc32_word(input [31:0] i_crc, input [31:0] i_data);
+		// {{{
+		integer		k;
+		reg	[31:0]	c;
+	begin
+		c = i_crc;
+		for(k=0; k<32; k=k+1)
+		if (c[0] ^ i_data[24 - 8*(k/8) + (k%8)])
+			c = (c >> 1) ^ 32'hedb88320;
+		else
+			c = c >> 1;
+		crc32_word = c;
+	end endfunction
+	// }}}
+
+	initial	crc = 1'b0;
+	always @(posedge i_clk)
+	if ((i_reset)||((i_wb_err)&&(o_wb_cyc)))
+		crc <= 1'b0;
+	else if ((i_cmd_special)&&(!o_cmd_busy)
+			&&(i_cmd_word[3:0] == `SPC_CRC))
+		crc <= 1'b1;
+	else if (blk_done)
+		crc <= 1'b0;
+
+	always @(posedge i_clk)
+	if ((i_cmd_special)&&(!o_cmd_busy)&&(i_cmd_word[3:0] == `SPC_CRC))
+		crc_reg <= 32'hffff_ffff;
+	else if ((crc)&&(blk_drop))
+		crc_reg <= crc32_word(crc_reg, i_wb_data);
+	// }}}
+
+	// fill, copy, cp_wr, cp_addr
+	// {{{
+	initial	fill = 1'b0;
+	always @(posedge i_clk)
+	if ((i_reset)||((i_wb_err)&&(o_wb_cyc)))
+		fill <= 1'b0;
+	else if ((w_args_done)&&(r_op == `SPC_FILL))
+		fill <= 1'b1;
+	else if (blk_done)
+		fill <= 1'b0;
+
+	initial	copy = 1'b0;
+	always @(posedge i_clk)
+	if ((i_reset)||((i_wb_err)&&(o_wb_cyc)))
+		copy <= 1'b0;
+	else if ((w_args_done)&&(r_op == `SPC_COPY))
+		copy <= 1'b1;
+	else if (blk_done)
+		copy <= 1'b0;
+
+	// A copy starts at the source address, as though a write had just
+	// completed
+	always @(posedge i_clk)
+	if ((w_args_done)&&(r_op == `SPC_COPY))
+		cp_wr <= 1'b1;
+	else if (copy_next)
+		cp_wr <= !cp_wr;
+
+	always @(posedge i_clk)
+	if ((w_args_done)&&(r_op == `SPC_COPY))
+		cp_addr <= i_cmd_word[AW+1:2];
+	else if (copy_next)
+		cp_addr <= o_wb_addr;
+
+	// Each copy request waits for the last to complete, so that the
+	// word read is in hand before it's written
+	assign	copy_next = (copy)&&(!o_wb_cyc)&&(burst_count != 0)
+				&&(w_credit);
+
+	assign	blk      = (crc)||(fill)||(copy);
+	assign	blk_drop = (blk)&&(o_wb_cyc)&&(i_wb_ack)&&(!i_wb_err);
+	assign	blk_done = (blk)&&(burst_count == 0)&&(!o_wb_cyc);
+	// }}}
+
+	// nargs, r_args
+	// {{{
+	initial	nargs = 0;
+	always @(posedge i_clk)
+	if (i_reset)
+		nargs <= 0;
+	else if ((i_cmd_special)&&(!o_cmd_busy)
+			&&(i_cmd_word[3:0] == `SPC_POLL))
+		nargs <= 2;
+	else if ((i_cmd_special)&&(!o_cmd_busy)
+			&&((i_cmd_word[3:0] == `SPC_FILL)
+				||(i_cmd_word[3:0] == `SPC_COPY)))
+		nargs <= 1;
+	else if (w_arg_abort)
+		nargs <= 0;
+	else if ((i_cmd_arg)&&(!o_cmd_busy))
+		nargs <= nargs - 1;
+
+	always @(posedge i_clk)
+	if ((i_cmd_special)&&(!o_cmd_busy))
+		r_op <= i_cmd_word[3:0];
+
+	always @(posedge i_clk)
+	if ((i_cmd_arg)&&(!o_cmd_busy))
+		r_args <= { r_args[31:0], i_cmd_word[31:0] };
+
+	// The last argument has arrived, and r_op may begin
+	assign	w_args_done = (i_cmd_arg)&&(!o_cmd_busy)&&(nargs == 1);
+
+	// Anything other than an argument, arriving before the last one has,
+	// aborts r_op.  That op is answered with a bus error in place of
+	// whatever it would have returned, and the command that aborted it
+	// is then taken as usual.
+	assign	w_arg_abort = (i_cmd_stb)&&(i_cmd_word[33])&&(nargs != 0)
+				&&(w_credit);
+
+	initial	argerr = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+		argerr <= 1'b0;
+	else if (w_arg_abort)
+		argerr <= 1'b1;
+	else if ((!rst_pending)&&(!o_wb_cyc)&&(err_count == 0))
+		// Its bus error response is generated this clock
+		argerr <= 1'b0;
+	// }}}
+
+	// poll, poll_timeout
+	// {{{
+	// A poll reads the same address, one read at a time, until the value
+	// read matches or we run out of time.  Only the read that ends the
+	// poll is answered, the responses to all the others are dropped.
+	initial	poll = 1'b0;
+	always @(posedge i_clk)
+	if ((i_reset)||((i_wb_err)&&(o_wb_cyc)))
+		poll <= 1'b0;
+	else if ((w_args_done)&&(r_op == `SPC_POLL))
+		poll <= 1'b1;
+	else if (poll_hit)
+		poll <= 1'b0;
+
+	always @(posedge i_clk)
+	if ((i_cmd_special)&&(!o_cmd_busy)&&(i_cmd_word[3:0] == `SPC_POLL))
+		poll_timeout <= i_cmd_word[31:4];
+	else if (poll_timeout != 0)
+		poll_timeout <= poll_timeout - 1;
+
+	assign	poll_next = (poll)&&(!o_wb_cyc)&&(w_credit);
+	assign	poll_hit  = (poll)&&(o_wb_cyc)&&(i_wb_ack)
+			&&(((i_wb_data & r_args[63:32]) == r_args[31:0])
+				||(poll_timeout == 0));
+	assign	poll_miss = (poll)&&(o_wb_cyc)&&(i_wb_ack)&&(!i_wb_err)
+			&&(!poll_hit);
 	// }}}
 
 	// o_wb_cyc, o_wb_stb
@@ -130,57 +485,39 @@ module	hbexec #(
 		// On any error or reset, then clear the bus.
 		o_wb_cyc <= 1'b0;
 		o_wb_stb <= 1'b0;
-	end else if (o_wb_stb)
+	end else if (w_issue)
 	begin
-		//
-		// BUS REQUEST state
-		//
+		// We've been asked to start a bus request from our command
+		// word, either RD or WR, or it's time for the next read of a
+		// burst.  This may start a new bus cycle, or continue the
+		// current one.
+		o_wb_cyc <= 1'b1;
+		o_wb_stb <= 1'b1;
+	end else begin
 		if (!i_wb_stall)
-			// If we are only going to do one transaction,
-			// then as soon as the stall line is lowered, we are
-			// done.
 			o_wb_stb <= 1'b0;
 
-		// While not likely, it is possible that a slave might ACK
-		// our request on the same clock it is received.  In that
-		// case, drop the CYC line.
-		//
-		// We gate this with the stall line in case we receive an
-		// ACK while our request has yet to go out.  This may make
-		// more sense later, when we are sending multiple back to back
-		// requests across the bus, but we'll leave this gate here
-		// as a placeholder until then.
-		if ((!i_wb_stall)&&(i_wb_ack))
-			o_wb_cyc <= 1'b0;
-	end else if (o_wb_cyc)
-	begin
-		//
-		// BUS WAIT
-		//
-		if (i_wb_ack)
-			// Once the slave acknowledges our request, we are done.
+		// Once the last request has been accepted and acknowledged,
+		// the cycle is complete.
+		if ((!o_wb_stb)&&(nout == { {(LGPIPE){1'b0}}, i_wb_ack }))
 			o_wb_cyc <= 1'b0;
-	end else begin
-		//
-		// IDLE state
-		//
-		if (i_cmd_bus)
-		begin
-			// We've been asked to start a bus cycle from our
-			// command word, either RD or WR
-			o_wb_cyc <= 1'b1;
-			o_wb_stb <= 1'b1;
-		end
 	end
 	// }}}
 
-	// For now, we'll use the bus cycle line as an indication of whether
-	// or not we are too busy to accept anything else from the command
-	// port.  This will change if we want to accept multiple write
-	// commands per bus cycle, but that will be a bus master that's
-	// not nearly so simple.
-	assign	o_cmd_busy = o_wb_cyc;
+	// nout
+	// {{{
+	assign	w_inflight = nout + { {(LGPIPE){1'b0}}, o_wb_stb };
 
+	initial	nout = 0;
+	always @(posedge i_clk)
+	if ((i_reset)||(!o_wb_cyc)||(i_wb_err))
+		nout <= 0;
+	else case({ (o_wb_stb)&&(!i_wb_stall), i_wb_ack })
+	2'b10: nout <= nout + 1'b1;
+	2'b01: nout <= nout - 1'b1;
+	default: begin end
+	endcase
+	// }}}
 
 	//
 	// The bus WE (write enable) line, governing wishbone direction
@@ -190,7 +527,8 @@ module	hbexec #(
 	// Hence, if CYC is low we can set the direction.
 	always @(posedge i_clk)
 	if (!o_wb_cyc)
-		o_wb_we <= (i_cmd_wr);
+		o_wb_we <= ((i_cmd_wr)&&(!o_cmd_busy))||(fill)
+				||((copy)&&(!cp_wr));
 
 	// o_wb_addr
 	// {{{
@@ -220,14 +558,19 @@ module	hbexec #(
 			// command word will tell us which, and we'll set this
 			// bit on any set address command.
 			inc <= !i_cmd_word[0];
-		end else if ((o_wb_stb)&&(!i_wb_stall))
+		end else if (copy_next)
+			// Swap between the copy's source and destination
+			o_wb_addr <= cp_addr;
+		else if ((o_wb_stb)&&(!i_wb_stall))
 			// The address lines are used while the bus is active,
 			// and referenced any time STB && !STALL are true.
 			//
 			// However, once STB and !STALL are both true, then the
 			// bus is ready to move to the next request.  Hence,
 			// we add our increment (one or zero) here.
-			o_wb_addr <= o_wb_addr + {{(AW-1){1'b0}}, inc};
+			// Polls, however, always read the same address.
+			o_wb_addr <= o_wb_addr + {{(AW-1){1'b0}},
+							(inc)&&(!poll) };
 
 
 		// We'd like to respond to the bus with any address we just
@@ -244,6 +587,32 @@ module	hbexec #(
 	end
 	// }}}
 
+	// capreq
+	// {{{
+	// As with newaddr, capreq flags that we owe the return channel a
+	// response--in this case our capabilities word.
+	initial	capreq = 1'b0;
+	always @(posedge i_clk)
+		capreq <= (!i_reset)&&(i_cmd_special)&&(!o_cmd_busy)
+				&&(i_cmd_word[3:0] == `SPC_CAPS);
+	// }}}
+
+	// modereq, mode
+	// {{{
+	// The mode switch is answered the same way, once the bus is idle, with
+	// the mode just selected
+	initial	modereq = 1'b0;
+	always @(posedge i_clk)
+		modereq <= (OPT_MODE)&&(!i_reset)&&(i_cmd_special)
+			&&(!o_cmd_busy)&&(i_cmd_word[3:0] == `SPC_MODE);
+
+	// Only those modes we support may be switched on
+	initial	mode = 2'b00;
+	always @(posedge i_clk)
+	if (!o_cmd_busy)
+		mode <= i_cmd_word[5:4] & { OPT_RLE, OPT_BINARY };
+	// }}}
+
 	//
 	// The bus DATA (output) lines
 	//
@@ -268,68 +637,167 @@ module	hbexec #(
 		// Thus we force these lines to be constant any time STB and
 		// STALL are both true, but set them otherwise.
 		//
-		if ((!o_wb_stb)||(!i_wb_stall))
-			o_wb_data <= i_cmd_word[31:0];
+		// A fill writes its argument.  A copy writes whatever it last
+		// read, and so holds that until its next read.
+		//
+		if (copy)
+		begin
+			if ((o_wb_cyc)&&(i_wb_ack)&&(!o_wb_we))
+				o_wb_data <= i_wb_data;
+		end else if ((!o_wb_stb)||(!i_wb_stall))
+			o_wb_data <= (fill) ? r_args[31:0] : i_cmd_word[31:0];
 	end
 	// }}}
 
-	//
-	// For this command bus channel, we'll only ever direct word addressing.
-	//
-	assign	o_wb_sel = 4'hf;
+	// r_sel
+	// {{{
+	// The byte enables for the next write.  These return to selecting
+	// every byte as soon as that write is accepted.
+	initial	r_sel = 4'hf;
+	always @(posedge i_clk)
+	if (i_reset)
+		r_sel <= 4'hf;
+	else if ((i_cmd_special)&&(!o_cmd_busy)
+			&&(i_cmd_word[3:0] == `SPC_SEL))
+		r_sel <= i_cmd_word[7:4];
+	else if ((i_cmd_wr)&&(!o_cmd_busy))
+		r_sel <= 4'hf;
+	// }}}
+
+	// o_wb_sel
+	// {{{
+	// As with o_wb_data, these are set along with any new request, and
+	// otherwise held while the slave stalls.  Only write commands use
+	// r_sel, everything else selects every byte.
+	initial	o_wb_sel = 4'hf;
+	always @(posedge i_clk)
+	if ((!o_wb_stb)||(!i_wb_stall))
+		o_wb_sel <= ((i_cmd_wr)&&(!o_cmd_busy)) ? r_sel : 4'hf;
+	// }}}
 
 	//
 	// The COMMAND RESPONSE return channel
 	//
 
-	// o_rsp_stb, o_rsp_word
+	// rst_pending, err_count
 	// {{{
-	// This is where we set o_rsp_stb and o_rsp_word for the return channel.
-	// The logic is set so that o_rsp_stb will be true for any one clock
-	// where we have data to reutrn, and zero otherwise.  If o_rsp_stb is
-	// true, then o_rsp_word is the response we want to return.  In all
-	// other cases, o_rsp_word is a don't care.
-	initial	o_rsp_stb = 1'b1;
-	initial	o_rsp_word = `RSP_RESET;
+	// Following any reset, we owe the return channel a reset response.
+	// Following a bus error, we owe it one bus error response for every
+	// other request the error aborted--unless those requests were part of
+	// a burst.
+	initial	rst_pending = 1'b1;
+	always @(posedge i_clk)
+		rst_pending <= i_reset;
+
+	initial	err_count = 0;
 	always @(posedge i_clk)
 	if (i_reset)
+		err_count <= 0;
+	else if ((o_wb_cyc)&&(i_wb_err))
+		err_count <= ((burst)||(w_inflight == 0)) ? 0
+				: (w_inflight - 1'b1);
+	else if (err_count != 0)
+		err_count <= err_count - 1'b1;
+	// }}}
+
+	// rsp_push, rsp_word
+	// {{{
+	// At most one response is generated on any clock.  Bus responses can
+	// only arrive during a bus cycle, whereas reset, error, address, and
+	// capability responses are only ever generated between them.
+	always @(*)
 	begin
-		o_rsp_stb <= 1'b1;
-		o_rsp_word <= `RSP_RESET;
-	end else if (i_wb_err)
-	begin
-		o_rsp_stb <= 1'b1;
-		o_rsp_word <= `RSP_BUS_ERROR;
-	end else if (o_wb_cyc) begin
-		//
-		// We're either in the BUS REQUEST or BUS WAIT states
-		//
-		// Either way, we want to return a response on our command
-		// channel if anything gets ack'd
-		o_rsp_stb <= (i_wb_ack);
-		//
-		//
-		if (o_wb_we)
-			o_rsp_word <= `RSP_WRITE_ACKNOWLEDGEMENT;
+		rsp_push = 1'b1;
+		rsp_word = `RSP_BUS_ERROR;
+
+		if (rst_pending)
+			rsp_word = `RSP_RESET;
+		else if ((o_wb_cyc)&&(i_wb_err))
+			rsp_word = `RSP_BUS_ERROR;
+		else if ((o_wb_cyc)&&(i_wb_ack))
+		begin
+			if (o_wb_we)
+				rsp_word = `RSP_WRITE_ACKNOWLEDGEMENT;
+			else
+				rsp_word = { `RSP_SUB_DATA, i_wb_data };
+
+			// Only the last read of a poll is answered, and no
+			// request of a CRC, fill, or copy
+			if ((poll_miss)||(blk_drop))
+				rsp_push = 1'b0;
+		end else if ((err_count != 0)||(argerr))
+			rsp_word = `RSP_BUS_ERROR;
+		else if (blk_done)
+			rsp_word = (crc) ? { `RSP_SUB_DATA, ~crc_reg }
+					: `RSP_WRITE_ACKNOWLEDGEMENT;
+		else if (newaddr)
+			// Echo any new addresses back up the command chain
+			rsp_word = { `RSP_SUB_ADDR,
+				{(30-ADDRESS_WIDTH){1'b0}}, o_wb_addr, 1'b0, !inc };
+		else if (capreq)
+			rsp_word = { `RSP_SUB_DATA, CAPABILITIES };
+		else if (modereq)
+			rsp_word = { `RSP_MODE, mode };
 		else
-			o_rsp_word <= { `RSP_SUB_DATA, i_wb_data };
-	end else begin
-		//
-		// We are in the IDLE state.
-		//
-		// Echo any new addresses back up the command chain
-		//
-		o_rsp_stb  <= newaddr;
-		o_rsp_word <= { `RSP_SUB_ADDR,
-			{(30-ADDRESS_WIDTH){1'b0}}, o_wb_addr, 1'b0, !inc };
+			rsp_push = 1'b0;
 	end
 	// }}}
 
+	// ncommit
+	// {{{
+	// Every request issued, and every address, capability, mode, CRC,
+	// fill, or copy command accepted (the latter two once their argument
+	// arrives), adds a response we owe.  Every response handed to the
+	// return channel removes one.  An error in a burst read also removes
+	// those responses the aborted requests will never produce, and an
+	// error in a CRC, fill, or copy the answer it replaces.  Every request
+	// that isn't answered on its own removes the response it would have
+	// produced.
+	initial	ncommit = 1;
+	always @(posedge i_clk)
+	if (i_reset)
+		ncommit <= 1;
+	else
+		ncommit <= ncommit
+			+ { {(LGPIPE){1'b0}}, (w_issue)
+				||((i_cmd_addr)&&(!o_cmd_busy))
+				||((i_cmd_special)&&(!o_cmd_busy)
+					&&(i_cmd_word[3:0] == `SPC_CAPS))
+				||((OPT_MODE)&&(i_cmd_special)
+					&&(!o_cmd_busy)
+					&&(i_cmd_word[3:0] == `SPC_MODE))
+				||((i_cmd_special)&&(!o_cmd_busy)
+					&&(i_cmd_word[3:0] == `SPC_CRC))
+				||((w_args_done)&&(r_op != `SPC_POLL))
+				||(w_arg_abort) }
+			- { {(LGPIPE){1'b0}}, rsp_pop }
+			- { {(LGPIPE){1'b0}}, (poll_miss)||(blk_drop) }
+			- { {(LGPIPE){1'b0}}, (o_wb_cyc)&&(i_wb_err)&&(blk) }
+			- (((o_wb_cyc)&&(i_wb_err)&&(burst)&&(w_inflight != 0))
+				? (w_inflight - 1'b1) : 0);
+	// }}}
+
+	// o_rsp_stb, o_rsp_word
+	// {{{
+	// Responses wait here until the return channel is ready for them.
+	// The logic above guarantees this FIFO never overflows.
+	hbfifo #(.BW(CW), .LGFLEN(LGPIPE))
+	rspfifo(
+		// {{{
+		.i_clk(i_clk), .i_reset(i_reset),
+		.i_stb(rsp_push), .i_word(rsp_word), .o_full(rsp_full),
+		.o_stb(o_rsp_stb), .o_word(o_rsp_word), .i_busy(i_rsp_busy)
+		// }}}
+	);
+
+	assign	rsp_pop = (o_rsp_stb)&&(!i_rsp_busy);
+	// }}}
+
 	// Make Verilator happy
 	// {{{
 	// verilator lint_off UNUSED
 	wire	unused;
-	assign	unused = &{ 1'b0, i_cmd_rd };
+	assign	unused = &{ 1'b0, i_cmd_rd, rsp_full };
 	// verilator lint_on UNUSED
 	// }}}
 `ifdef	FORMAL
@@ -348,7 +816,7 @@ module	hbexec #(
 
 	initial	`ASSUME(i_reset);
 
-	localparam	F_LGDEPTH=2;
+	localparam	F_LGDEPTH=LGPIPE+1;
 	wire	[F_LGDEPTH-1:0]	f_nreqs, f_nacks, f_outstanding;
 
 	fwb_master #( .AW(AW),.F_MAX_STALL(3),.F_MAX_ACK_DELAY(3),
@@ -359,22 +827,19 @@ module	hbexec #(
 				i_wb_err,
 			f_nreqs, f_nacks, f_outstanding);
 
-	always @(posedge i_clk)
-	if ((f_outstanding > 1)||(o_wb_stb))
-		assume(!i_cmd_stb);
-
 	always @(posedge i_clk)
 	if ((!f_past_valid)||($past(i_reset)))
 	begin
 		`ASSUME(!i_cmd_stb);
 		//
-		`ASSERT(o_rsp_stb);
-		`ASSERT(o_rsp_word == `RSP_RESET);
+		`ASSERT(rst_pending);
+		`ASSERT(!o_wb_cyc);
+		`ASSERT(ncommit == 1);
 	end
 
 	always @(*)
-	if (o_wb_cyc)
-		`ASSERT(o_cmd_busy);
+	if (rst_pending)
+		`ASSERT((rsp_push)&&(rsp_word == `RSP_RESET));
 
 	always @(posedge i_clk)
 	if ((f_past_valid)&&($past(o_cmd_busy))&&($past(i_cmd_stb)))
@@ -383,6 +848,122 @@ module	hbexec #(
 		assume($stable(i_cmd_word));
 	end
 
+	// Our count of outstanding requests matches the bus' count
+	always @(*)
+	if (o_wb_cyc)
+		`ASSERT(f_outstanding == nout);
+	else
+		`ASSERT((nout == 0)&&(!o_wb_stb));
+
+	// f_rsp_fill, the number of responses waiting in the response FIFO
+	reg	[LGPIPE:0]	f_rsp_fill;
+
+	initial	f_rsp_fill = 0;
+	always @(posedge i_clk)
+	if (i_reset)
+		f_rsp_fill <= 0;
+	else case({ (rsp_push)&&(!rsp_full), rsp_pop })
+	2'b10: f_rsp_fill <= f_rsp_fill + 1'b1;
+	2'b01: f_rsp_fill <= f_rsp_fill - 1'b1;
+	default: begin end
+	endcase
+
+	always @(*)
+		`ASSERT(o_rsp_stb == (f_rsp_fill != 0));
+
+	always @(*)
+	if (rsp_push)
+		`ASSERT(!rsp_full);
+
+	// We never owe more responses than the response FIFO can hold, and
+	// every response we owe is either in flight, pending, or in the FIFO
+	always @(*)
+	begin
+		`ASSERT(ncommit <= PIPEDEPTH);
+		`ASSERT(ncommit == f_rsp_fill + w_inflight + err_count
+				+ { {(LGPIPE){1'b0}}, newaddr }
+				+ { {(LGPIPE){1'b0}}, capreq }
+				+ { {(LGPIPE){1'b0}}, modereq }
+				+ { {(LGPIPE){1'b0}}, blk }
+				+ { {(LGPIPE){1'b0}}, rst_pending }
+				+ { {(LGPIPE){1'b0}}, argerr });
+	end
+
+	// CRCs and fills are bursts, copies aren't, and their answers are
+	// only given once they complete
+	always @(*)
+	begin
+		`ASSERT(crc + fill + copy + poll <= 1);
+		if ((crc)||(fill))
+			`ASSERT(burst);
+		if (copy)
+			`ASSERT((!burst)&&(w_inflight <= 1));
+		if ((fill)&&(o_wb_cyc))
+			`ASSERT(o_wb_we);
+	end
+
+	// Responses owed between bus cycles are only owed between bus cycles
+	always @(*)
+	if ((err_count != 0)||(newaddr)||(capreq)||(modereq)||(rst_pending)
+			||(argerr))
+		`ASSERT(!o_wb_cyc);
+
+	// A special waiting on its arguments is never overwritten by another
+	// command.  Nothing else is owed, and the bus is idle, until they
+	// arrive.
+	always @(posedge i_clk)
+	if ((f_past_valid)&&(!$past(i_reset))&&($past(nargs != 0))
+			&&(nargs != 0))
+		`ASSERT($stable(r_op));
+
+	always @(*)
+	if (nargs != 0)
+	begin
+		`ASSERT((!o_wb_cyc)&&(!burst)&&(!poll)&&(!blk));
+		`ASSERT((err_count == 0)&&(!newaddr)&&(!capreq)&&(!modereq));
+		`ASSERT(!argerr);
+		`ASSERT((r_op == `SPC_POLL)||(r_op == `SPC_FILL)
+				||(r_op == `SPC_COPY));
+	end
+
+	always @(*)
+	if ((argerr)&&(!rst_pending))
+		`ASSERT((rsp_push)&&(rsp_word == `RSP_BUS_ERROR));
+
+	always @(*)
+	if ((burst)&&(!fill)&&(o_wb_cyc))
+		`ASSERT(!o_wb_we);
+
+	// A copy reads (cp_wr clear) and then writes what it read, and only
+	// counts a word once it's been written
+	always @(*)
+	if (copy)
+	begin
+		if (o_wb_cyc)
+			`ASSERT(o_wb_we == cp_wr);
+		if (!cp_wr)
+			`ASSERT(burst_count != 0);
+	end
+
+	// Once complete, a CRC is answered with its CRC, and a fill or copy
+	// with an acknowledgement
+	always @(*)
+	if ((blk_done)&&(!rst_pending)&&(err_count == 0)&&(!argerr))
+		`ASSERT((rsp_push)&&(rsp_word == ((crc)
+				? { `RSP_SUB_DATA, ~crc_reg }
+				: `RSP_WRITE_ACKNOWLEDGEMENT)));
+
+	// Polls only ever issue one read at a time, and only once their
+	// arguments have arrived
+	always @(*)
+	if (poll)
+	begin
+		`ASSERT(nargs == 0);
+		`ASSERT(!burst);
+		if (o_wb_cyc)
+			`ASSERT((!o_wb_we)&&(w_inflight <= 1));
+	end
+
 	always @(posedge i_clk)
 	if ((f_past_valid)&&(!$past(i_reset))
 			&&($past(i_cmd_addr))&&(!$past(o_cmd_busy)))
@@ -394,45 +975,72 @@ module	hbexec #(
 			`ASSERT(o_wb_addr == $past(i_cmd_word[AW+1:2]));
 	end
 
-	always @(posedge i_clk)
-	if ((f_past_valid)&&(!$past(i_reset))&&($past(newaddr)))
+	always @(*)
+	if ((newaddr)&&(!rst_pending))
+		`ASSERT((rsp_push)&&(rsp_word == { `RSP_SUB_ADDR,
+				o_wb_addr, 1'b0, !inc }));
+
+	always @(*)
+	if ((capreq)&&(!rst_pending)&&(!newaddr))
+		`ASSERT((rsp_push)
+			&&(rsp_word == { `RSP_SUB_DATA, CAPABILITIES }));
+
+	always @(*)
+	if ((modereq)&&(!rst_pending)&&(!newaddr)&&(!capreq))
+		`ASSERT((rsp_push)&&(rsp_word == { `RSP_MODE, mode }));
+
+	always @(*)
+	if (!OPT_MODE)
+		`ASSERT(!modereq);
+
+	// Reads always select every byte
+	always @(*)
+	if ((o_wb_stb)&&(!o_wb_we))
+		`ASSERT(o_wb_sel == 4'hf);
+
+	always @(*)
 	begin
-		`ASSERT(o_rsp_stb  == 1'b1);
-		`ASSERT(o_rsp_word == { `RSP_SUB_ADDR,
-				$past(o_wb_addr), 1'b0, !$past(inc) });
+		if (!OPT_BINARY)
+			`ASSERT(!mode[0]);
+		if (!OPT_RLE)
+			`ASSERT(!mode[1]);
 	end
 
 	always @(posedge i_clk)
 	if ((f_past_valid)&&($past(o_wb_cyc))&&(o_wb_cyc))
 		`ASSERT($stable(o_wb_we));
 
-	always @(posedge i_clk)
-	if ((f_past_valid)&&(!$past(i_reset))
-			&&($past(o_wb_cyc))&&($past(i_wb_ack)))
+	always @(*)
+	if ((o_wb_cyc)&&(i_wb_ack)&&(!i_wb_err)&&(!poll_miss)&&(!blk_drop))
 	begin
-		if ($past(o_wb_we))
-			`ASSERT(o_rsp_word == `RSP_WRITE_ACKNOWLEDGEMENT);
+		`ASSERT(rsp_push);
+		if (o_wb_we)
+			`ASSERT(rsp_word == `RSP_WRITE_ACKNOWLEDGEMENT);
 		else
-			`ASSERT(o_rsp_word == { `RSP_SUB_DATA, $past(i_wb_data) });
+			`ASSERT(rsp_word == { `RSP_SUB_DATA, i_wb_data });
 	end
 
-	always @(posedge i_clk)
-	if ((f_past_valid)&&($past(i_reset)))
-		`ASSERT((o_rsp_stb)&&(o_rsp_word == `RSP_RESET));
+	always @(*)
+	if ((o_wb_cyc)&&(i_wb_err))
+		`ASSERT((rsp_push)&&(rsp_word == `RSP_BUS_ERROR));
 
 	always @(posedge i_clk)
 	if ((f_past_valid)&&(!$past(i_reset))
-			&&($past(o_wb_cyc))&&($past(i_wb_err)))
-		`ASSERT((o_rsp_stb)&&(o_rsp_word == `RSP_BUS_ERROR));
+			&&($past(i_cmd_bus))&&(!$past(o_cmd_busy)))
+	begin
+		`ASSERT((o_wb_cyc)&&(o_wb_stb));
+		`ASSERT(o_wb_we == $past(i_cmd_word[32]));
+	end
 
+	// A burst of N reads issues exactly N requests
 	always @(posedge i_clk)
-	if ((f_past_valid)&&(!$past(i_reset))
-			&&($past(i_cmd_addr))&&(!$past(o_cmd_busy)))
+	if ((f_past_valid)&&(!$past(i_reset))&&($past(burst))
+			&&(!$past(i_wb_err)))
 	begin
-		if ($past(i_cmd_wr))
-			`ASSERT((o_wb_cyc)&&(o_wb_stb)&&(o_wb_we));
-		if ($past(i_cmd_rd))
-			`ASSERT((o_wb_cyc)&&(o_wb_stb)&&(!o_wb_we));
+		if ($past(burst_next))
+			`ASSERT(burst_count == $past(burst_count) - 1);
+		else
+			`ASSERT(burst_count == $past(burst_count));
 	end
 
 `endif
@@ -16,6 +16,39 @@
 //		bit[1] is an address difference bit
 //		bit[0] is an increment bit
 //	2'b11	Special command
+//		The bottom four bits select the command, the rest are its
+//		argument.  As with hbexec, 4'h0 is the capability query,
+//		4'h1 a burst read of the argument's number of words, and
+//		4'h2 (if OPT_BINARY or OPT_RLE is set) a switch to or from
+//		the binary protocol, or read response compression.  4'h3 sets
+//		the write strobes (WSTRB) of the next write to bits [7:4] of
+//		its argument.  4'h4 polls: the next two read or write commands
+//		supply a mask and an expected value, and the current address
+//		is read until its value matches under the mask, or until the
+//		argument's number of clocks have passed.  Only the last value
+//		read is returned.  4'h5 reads the argument's number of words,
+//		as a burst would, but returns only their CRC32.  4'h6 fills
+//		the argument's number of words with the value of the next read
+//		or write command, and 4'h7 copies that many words to the
+//		current address from the (byte) address the next read or write
+//		command supplies.  Fills and copies return a single write
+//		acknowledgement.
+//
+//	AXI interconnects can take many clocks to answer each request.  Hence,
+//	up to 2^LGPIPE requests may be outstanding at once.  Consecutive
+//	reads, or consecutive writes, are issued one per clock as long as the
+//	bus accepts them, and their responses are collected in order.  Reads
+//	and writes are never outstanding at the same time, so that responses
+//	are always returned in the order the commands were given.  Responses
+//	wait in a 2^LGPIPE word FIFO until the return channel (i_rsp_busy) is
+//	ready for them, and no request is ever issued unless there's room in
+//	this FIFO for its response.
+//
+//	Unlike Wishbone, an AXI bus error doesn't abort anything.  Every read
+//	or write command therefore receives its own response, be it a bus
+//	error or not.  Only bursts, CRCs, fills, and copies are cut short by
+//	a bus error: nothing more is issued, and the rest of their responses
+//	are dropped, so that each is answered with a single bus error.
 //
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
@@ -53,10 +86,31 @@ module	hbexecaxi #(
 		// {{{
 		parameter	ADDRESS_WIDTH=30,
 		parameter [0:0]	OPT_LOWPOWER=1'b0,
+		// LGFIFO is the log, base two, of the depth of any command
+		// FIFO feeding this core.  As with hbexec, it is only reported
+		// to the host.
+		parameter [3:0]	LGFIFO = 4'h0,
+		// LGPIPE is the log, base two, of the number of AXI requests
+		// that may be outstanding at once.  It must be at least one.
+		parameter [3:0]	LGPIPE = 4'h3,
+		// OPT_BINARY and OPT_RLE enable the mode switch command, as
+		// with hbexec
+		parameter [0:0]	OPT_BINARY = 1'b0,
+		parameter [0:0]	OPT_RLE = 1'b0,
 		// Shorthand for address width
 		localparam	AW=ADDRESS_WIDTH,
 				CW=34,	// Command word width
-		localparam	DW=32
+		localparam	DW=32,
+		// CAPABILITIES, as with hbexec: the capability query, burst
+		// reads, byte enables, polling, CRCs, fills, copies, and
+		// (optionally) the mode switch are supported, [19:16] are
+		// LGFIFO, [23:20] are LGPIPE, and [25:24] the modes that may
+		// be switched on.
+		localparam [0:0]	OPT_MODE = (OPT_BINARY)||(OPT_RLE),
+		localparam [31:0]	CAPABILITIES = { 6'h0, OPT_RLE,
+						OPT_BINARY, LGPIPE, LGFIFO,
+						8'h0, 5'h1f, OPT_MODE, 2'b11 },
+		localparam	PIPEDEPTH = (1<<LGPIPE)
 		// }}}
 	) (
 		// {{{
@@ -66,8 +120,9 @@ module	hbexecaxi #(
 		input	wire	[(CW-1):0]	i_cmd_word,
 		output	wire			o_cmd_busy,
 		// The return command channel
-		output	reg			o_rsp_stb,
-		output	reg	[(CW-1):0]	o_rsp_word,
+		input	wire			i_rsp_busy,
+		output	wire			o_rsp_stb,
+		output	wire	[(CW-1):0]	o_rsp_word,
 		// AXI Write Channel
 		// {{{
 		output	reg			M_AXI_AWVALID,
@@ -78,10 +133,10 @@ module	hbexecaxi #(
 		output	reg			M_AXI_WVALID,
 		input	wire			M_AXI_WREADY,
 		output	reg	[DW-1:0]	M_AXI_WDATA,
-		output	wire	[3:0]		M_AXI_WSTRB,
+		output	reg	[3:0]		M_AXI_WSTRB,
 		//
 		input	wire			M_AXI_BVALID,
-		output	reg			M_AXI_BREADY,
+		output	wire			M_AXI_BREADY,
 		input	wire	[1:0]		M_AXI_BRESP,
 		// }}}
 		// AXI Read channel
@@ -92,7 +147,7 @@ module	hbexecaxi #(
 		output	wire	[2:0]		M_AXI_ARPROT,
 		//
 		input	wire			M_AXI_RVALID,
-		output	reg			M_AXI_RREADY,
+		output	wire			M_AXI_RREADY,
 		input	wire	[DW-1:0]	M_AXI_RDATA,
 		input	wire	[1:0]		M_AXI_RRESP
 		// }}}
@@ -105,7 +160,7 @@ module	hbexecaxi #(
 				CMD_SUB_ADDR =	2'b10,
 				CMD_SUB_SPECIAL=2'b11;
 	// Verilator lint_on  UNUSED
-	// localparam [0:0]	CMD_SUB_BUS = 1'b0;
+	localparam [0:0]	CMD_SUB_BUS = 1'b0;
 	localparam [1:0]	RSP_SUB_DATA =	2'b00,
 				RSP_SUB_ACK =	2'b01,
 				RSP_SUB_ADDR =	2'b10,
@@ -115,80 +170,395 @@ module	hbexecaxi #(
 						= { RSP_SUB_ACK, 32'h0 },
 				RSP_RESET = { RSP_SUB_SPECIAL, 3'h0, 29'h00 },
 				RSP_BUS_ERROR={ RSP_SUB_SPECIAL, 3'h1, 29'h00 };
+	localparam [31:0]	RSP_MODE = { RSP_SUB_SPECIAL, 3'h4, 27'h00 };
+
+	localparam [3:0]	SPC_CAPS  = 4'h0,
+				SPC_BURST = 4'h1,
+				SPC_MODE  = 4'h2,
+				SPC_SEL   = 4'h3,
+				SPC_POLL  = 4'h4,
+				SPC_CRC   = 4'h5,
+				SPC_FILL  = 4'h6,
+				SPC_COPY  = 4'h7;
 
 
 	//
 	//
 	reg	[(CW-1):0]	rsp_word;
-	reg			newaddr, inc;
+	reg			rsp_push;
+	wire			rsp_pop, rsp_full;
+	wire	[(CW-1):0]	fifo_word;
+	reg			newaddr, inc, capreq, modereq, rst_pending,
+				argerr;
+	reg	[1:0]		mode;
+	reg	[3:0]		r_sel;
+	reg			wr;
+	reg			burst, burst_err;
+	reg	[27:0]		burst_count;
+	wire			burst_next, w_issue, w_credit, w_free, w_return,
+				w_drop;
+	// As with hbexec, nargs counts the argument words the special command
+	// r_op still needs, and r_args collects them
+	reg	[1:0]		nargs;
+	reg	[3:0]		r_op;
+	reg	[63:0]		r_args;
+	wire			w_args_done, w_arg_abort;
+	reg			poll;
+	reg	[27:0]		poll_timeout;
+	wire			poll_next, poll_hit, poll_miss;
+	// CRCs, fills, and copies (blk) are answered once, when complete
+	reg			crc, fill, copy, cp_wr;
+	reg	[31:0]		crc_reg, cp_data;
+	reg	[(AW-1):0]	cp_addr;
+	wire			blk, blk_drop, blk_fail, blk_done, copy_next;
+	wire			w_rd_issue, w_wr_issue, w_err;
+	// nout counts requests issued, whose responses haven't yet returned.
+	// ncommit counts every response owed to the return channel, including
+	// those waiting in the response FIFO.
+	reg	[LGPIPE:0]	nout, ncommit;
 
 	//
 	// Decode our input commands
 	//
-	wire	i_cmd_addr, i_cmd_wr, i_cmd_rd;
+	wire	i_cmd_addr, i_cmd_wr, i_cmd_rd, i_cmd_bus, i_cmd_caps,
+		i_cmd_burst, i_cmd_mode, i_cmd_sel, i_cmd_poll, i_cmd_arg,
+		i_cmd_crc, i_cmd_fill, i_cmd_copy;
 	assign	i_cmd_addr = (i_cmd_stb && !o_cmd_busy)&&(i_cmd_word[33:32] == CMD_SUB_ADDR);
-	assign	i_cmd_rd   = (i_cmd_stb && !o_cmd_busy)&&(i_cmd_word[33:32] == CMD_SUB_RD);
-	assign	i_cmd_wr   = (i_cmd_stb && !o_cmd_busy)&&(i_cmd_word[33:32] == CMD_SUB_WR);
+	assign	i_cmd_rd   = (i_cmd_stb && !o_cmd_busy)&&(i_cmd_word[33:32] == CMD_SUB_RD)&&(nargs == 0);
+	assign	i_cmd_wr   = (i_cmd_stb && !o_cmd_busy)&&(i_cmd_word[33:32] == CMD_SUB_WR)&&(nargs == 0);
+	assign	i_cmd_bus  = (i_cmd_stb && !o_cmd_busy)&&(i_cmd_word[33] == CMD_SUB_BUS)&&(nargs == 0);
+	assign	i_cmd_arg  = (i_cmd_stb && !o_cmd_busy)&&(i_cmd_word[33] == CMD_SUB_BUS)&&(nargs != 0);
+	assign	i_cmd_caps = (i_cmd_stb && !o_cmd_busy)
+			&&(i_cmd_word[33:32] == CMD_SUB_SPECIAL)
+			&&(i_cmd_word[3:0] == SPC_CAPS);
+	assign	i_cmd_burst= (i_cmd_stb && !o_cmd_busy)
+			&&(i_cmd_word[33:32] == CMD_SUB_SPECIAL)
+			&&(i_cmd_word[3:0] == SPC_BURST);
+	assign	i_cmd_mode = (OPT_MODE)&&(i_cmd_stb && !o_cmd_busy)
+			&&(i_cmd_word[33:32] == CMD_SUB_SPECIAL)
+			&&(i_cmd_word[3:0] == SPC_MODE);
+	assign	i_cmd_sel  = (i_cmd_stb && !o_cmd_busy)
+			&&(i_cmd_word[33:32] == CMD_SUB_SPECIAL)
+			&&(i_cmd_word[3:0] == SPC_SEL);
+	assign	i_cmd_poll = (i_cmd_stb && !o_cmd_busy)
+			&&(i_cmd_word[33:32] == CMD_SUB_SPECIAL)
+			&&(i_cmd_word[3:0] == SPC_POLL);
+	assign	i_cmd_crc  = (i_cmd_stb && !o_cmd_busy)
+			&&(i_cmd_word[33:32] == CMD_SUB_SPECIAL)
+			&&(i_cmd_word[3:0] == SPC_CRC);
+	assign	i_cmd_fill = (i_cmd_stb && !o_cmd_busy)
+			&&(i_cmd_word[33:32] == CMD_SUB_SPECIAL)
+			&&(i_cmd_word[3:0] == SPC_FILL);
+	assign	i_cmd_copy = (i_cmd_stb && !o_cmd_busy)
+			&&(i_cmd_word[33:32] == CMD_SUB_SPECIAL)
+			&&(i_cmd_word[3:0] == SPC_COPY);
+
+	// o_cmd_busy
+	// {{{
+	// w_free is true if every channel we might issue a request on is
+	// either idle, or handing off its current request on this clock.
+	assign	w_free = (!M_AXI_ARVALID || M_AXI_ARREADY)
+			&&(!M_AXI_AWVALID || M_AXI_AWREADY)
+			&&(!M_AXI_WVALID  || M_AXI_WREADY);
+	assign	w_credit = (ncommit < PIPEDEPTH);
+
+	// Reads may follow reads, and writes may follow writes, while earlier
+	// requests are outstanding.  Anything else waits for the bus to go
+	// idle.  As with hbexec, an address or special arriving while a
+	// special is still waiting on its arguments waits while that special
+	// is aborted.
+	assign	o_cmd_busy = (burst)||(poll)||(copy)||(rst_pending)||(newaddr)
+			||(capreq)||(modereq)||(argerr)
+			||((i_cmd_word[33])&&(nargs != 0))
+			||(!w_credit)||(!w_free)
+			||((nout != 0)&&((i_cmd_word[33] != CMD_SUB_BUS)
+				||(i_cmd_word[32] != wr)));
+
+	// A fill is a burst of writes, and a copy alternates between reading
+	// and writing
+	assign	w_wr_issue = (i_cmd_wr)||((burst_next)&&(fill))
+			||((copy_next)&&(!cp_wr));
+	assign	w_rd_issue = (i_cmd_rd)||((burst_next)&&(!fill))||(poll_next)
+			||((copy_next)&&(cp_wr));
+	assign	w_issue = (w_wr_issue)||(w_rd_issue);
+
+	// Any failed request
+	assign	w_err = ((M_AXI_RVALID)&&(M_AXI_RREADY)&&(M_AXI_RRESP[1]))
+			||((M_AXI_BVALID)&&(M_AXI_BREADY)&&(M_AXI_BRESP[1]));
+	// }}}
+
+	// wr
+	// {{{
+	// The direction of any outstanding requests.  This can only change
+	// when nothing is outstanding.
+	initial	wr = 1'b0;
+	always @(posedge i_clk)
+	if (nout == 0)
+		wr <= ((i_cmd_stb)&&(i_cmd_word[33:32] == CMD_SUB_WR)
+			&&(nargs == 0)&&(!burst)&&(!poll)&&(!copy))
+			||(fill)||((copy)&&(!cp_wr));
+	// }}}
+
+	// burst, burst_count, burst_err
+	// {{{
+	// As with hbexec, a burst read issues its reads as fast as the bus and
+	// the response FIFO allow, and then waits for them all to return.  A
+	// bus error stops the burst from issuing anything more, and sets
+	// burst_err so that the responses still to come are dropped.  A CRC
+	// is a burst as well, even if it reads nothing, and so is a fill--a
+	// burst of writes.
+	initial	burst = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+		burst <= 1'b0;
+	else if (i_cmd_burst)
+		burst <= (i_cmd_word[31:4] != 0);
+	else if (i_cmd_crc)
+		burst <= 1'b1;
+	else if ((w_args_done)&&(r_op == SPC_FILL))
+		burst <= 1'b1;
+	else if ((burst_count == 0)&&(nout == 0))
+		burst <= 1'b0;
+
+	initial	burst_count = 0;
+	always @(posedge i_clk)
+	if ((i_reset)||(w_err))
+		burst_count <= 0;
+	else if ((i_cmd_burst)||(i_cmd_crc)||(i_cmd_fill)||(i_cmd_copy))
+		burst_count <= i_cmd_word[31:4];
+	else if ((burst_next)||((copy_next)&&(!cp_wr)))
+		burst_count <= burst_count - 1;
+
+	initial	burst_err = 1'b0;
+	always @(posedge i_clk)
+	if ((i_reset)||(!burst)||((burst_count == 0)&&(nout == 0)))
+		burst_err <= 1'b0;
+	else if (w_err)
+		burst_err <= 1'b1;
 
-	// AWVALID, WVALID, BREADY
+	assign	burst_next = (burst)&&(burst_count != 0)&&(!burst_err)
+			&&(w_credit)&&(w_free)&&(!w_err);
+	// }}}
+
+	// crc, crc_reg
+	// {{{
+	// The same CRC32 as hbexec: reflected, polynomial 0xedb88320, starting
+	// from all ones and complemented at the end, taking each word from its
+	// most significant byte to its least
+	function [31:0]	crc32_word(input [31:0] i_crc, input [31:0] i_data);
+		// {{{
+		integer		k;
+		reg	[31:0]	c;
+	begin
+		c = i_crc;
+		for(k=0; k<32; k=k+1)
+		if (c[0] ^ i_data[24 - 8*(k/8) + (k%8)])
+			c = (c >> 1) ^ 32'hedb88320;
+		else
+			c = c >> 1;
+		crc32_word = c;
+	end endfunction
+	// }}}
+
+	// A bus error answers the CRC in its place
+	initial	crc = 1'b0;
+	always @(posedge i_clk)
+	if ((i_reset)||(blk_fail))
+		crc <= 1'b0;
+	else if (i_cmd_crc)
+		crc <= 1'b1;
+	else if (blk_done)
+		crc <= 1'b0;
+
+	always @(posedge i_clk)
+	if (i_cmd_crc)
+		crc_reg <= 32'hffff_ffff;
+	else if ((crc)&&(blk_drop))
+		crc_reg <= crc32_word(crc_reg, M_AXI_RDATA);
+	// }}}
+
+	// fill, copy, cp_wr, cp_addr, cp_data
+	// {{{
+	// As with the CRC, a bus error answers either of these in its place
+	initial	fill = 1'b0;
+	always @(posedge i_clk)
+	if ((i_reset)||(blk_fail))
+		fill <= 1'b0;
+	else if ((w_args_done)&&(r_op == SPC_FILL))
+		fill <= 1'b1;
+	else if (blk_done)
+		fill <= 1'b0;
+
+	initial	copy = 1'b0;
+	always @(posedge i_clk)
+	if ((i_reset)||(blk_fail))
+		copy <= 1'b0;
+	else if ((w_args_done)&&(r_op == SPC_COPY))
+		copy <= 1'b1;
+	else if (blk_done)
+		copy <= 1'b0;
+
+	// A copy swaps between its source and destination addresses with
+	// every request, starting with a read from the source
+	always @(posedge i_clk)
+	if ((w_args_done)&&(r_op == SPC_COPY))
+		cp_wr <= 1'b1;
+	else if (copy_next)
+		cp_wr <= !cp_wr;
+
+	always @(posedge i_clk)
+	if ((w_args_done)&&(r_op == SPC_COPY))
+		cp_addr <= i_cmd_word[AW+1:2];
+	else if (copy_next)
+		cp_addr <= M_AXI_AWADDR[AW+1:2];
+
+	always @(posedge i_clk)
+	if ((copy)&&(M_AXI_RVALID)&&(M_AXI_RREADY))
+		cp_data <= M_AXI_RDATA;
+
+	// One copy request at a time, so the word read is in hand before
+	// it's written
+	assign	copy_next = (copy)&&(nout == 0)&&(burst_count != 0)
+				&&(w_credit)&&(w_free);
+
+	assign	blk      = (crc)||(fill)||(copy);
+	assign	blk_drop = (blk)&&(w_return)&&(!w_err);
+	assign	blk_fail = (blk)&&(w_err);
+	assign	blk_done = (blk)&&(burst_count == 0)&&(nout == 0);
+	// }}}
+
+	// nargs, r_args
+	// {{{
+	initial	nargs = 0;
+	always @(posedge i_clk)
+	if (i_reset)
+		nargs <= 0;
+	else if (w_arg_abort)
+		nargs <= 0;
+	else if (i_cmd_poll)
+		nargs <= 2;
+	else if ((i_cmd_fill)||(i_cmd_copy))
+		nargs <= 1;
+	else if (i_cmd_arg)
+		nargs <= nargs - 1;
+
+	always @(posedge i_clk)
+	if ((i_cmd_stb)&&(!o_cmd_busy)
+			&&(i_cmd_word[33:32] == CMD_SUB_SPECIAL))
+		r_op <= i_cmd_word[3:0];
+
+	always @(posedge i_clk)
+	if (i_cmd_arg)
+		r_args <= { r_args[31:0], i_cmd_word[31:0] };
+
+	assign	w_args_done = (i_cmd_arg)&&(nargs == 1);
+
+	// Anything other than an argument, arriving before the last one has,
+	// aborts r_op, which is then answered with a bus error
+	assign	w_arg_abort = (i_cmd_stb)&&(i_cmd_word[33])&&(nargs != 0)
+				&&(w_credit);
+
+	initial	argerr = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+		argerr <= 1'b0;
+	else if (w_arg_abort)
+		argerr <= 1'b1;
+	else if (!rst_pending)
+		// Its bus error response is generated this clock
+		argerr <= 1'b0;
+	// }}}
+
+	// poll, poll_timeout
+	// {{{
+	// A poll issues one read at a time, dropping the response to each,
+	// until a read matches, times out, or fails
+	initial	poll = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+		poll <= 1'b0;
+	else if ((w_args_done)&&(r_op == SPC_POLL))
+		poll <= 1'b1;
+	else if (poll_hit)
+		poll <= 1'b0;
+
+	always @(posedge i_clk)
+	if (i_cmd_poll)
+		poll_timeout <= i_cmd_word[31:4];
+	else if (poll_timeout != 0)
+		poll_timeout <= poll_timeout - 1;
+
+	assign	poll_next = (poll)&&(nout == 0)&&(w_credit);
+	assign	poll_hit  = (poll)&&(M_AXI_RVALID)&&(M_AXI_RREADY)
+			&&(((M_AXI_RDATA & r_args[63:32]) == r_args[31:0])
+				||(poll_timeout == 0)||(M_AXI_RRESP[1]));
+	assign	poll_miss = (poll)&&(M_AXI_RVALID)&&(M_AXI_RREADY)
+			&&(!poll_hit);
+	// }}}
+
+	// AWVALID, WVALID
 	// {{{
 	initial	M_AXI_AWVALID = 0;
 	initial	M_AXI_WVALID = 0;
-	initial	M_AXI_BREADY = 0;
 
 	always @(posedge i_clk)
 	if (i_reset)
 	begin
 		M_AXI_AWVALID <= 0;
 		M_AXI_WVALID  <= 0;
-		M_AXI_BREADY <= 0;
 		//
-	end else if (M_AXI_BREADY)
+	end else if (w_wr_issue)
 	begin
-		// We are waiting on a return
-		if (M_AXI_BVALID)
-			M_AXI_BREADY <= 0;
-
+		M_AXI_AWVALID <= 1;
+		M_AXI_WVALID  <= 1;
+	end else begin
 		if (M_AXI_AWREADY)
 			M_AXI_AWVALID <= 0;
 		if (M_AXI_WREADY)
 			M_AXI_WVALID <= 0;
-	end else if (i_cmd_wr)
-	begin
-		M_AXI_AWVALID <= 1;
-		M_AXI_WVALID  <= 1;
-		M_AXI_BREADY  <= 1;
 	end
 	// }}}
 
-	// ARVALID, RREADY
+	// ARVALID
 	// {{{
 	initial	M_AXI_ARVALID = 0;
-	initial	M_AXI_RREADY = 0;
 	always @(posedge i_clk)
 	if (i_reset)
-	begin
 		M_AXI_ARVALID <= 0;
-		M_AXI_RREADY <= 0;
-	end else if (M_AXI_RREADY)
-	begin
-		// We are waiting on a return
-		if (M_AXI_ARREADY)
-			M_AXI_ARVALID <= 0;
-
-		if (M_AXI_RVALID)
-			M_AXI_RREADY <= 0;
-	end else if (i_cmd_rd)
-	begin
+	else if (w_rd_issue)
 		M_AXI_ARVALID <= 1;
-		M_AXI_RREADY  <= 1;
-	end
+	else if (M_AXI_ARREADY)
+		M_AXI_ARVALID <= 0;
+	// }}}
+
+	// BREADY, RREADY
+	// {{{
+	// Room for every response has already been set aside in the response
+	// FIFO, so we're always ready for any response we're expecting.
+	assign	M_AXI_BREADY = (nout != 0)&&( wr);
+	assign	M_AXI_RREADY = (nout != 0)&&(!wr);
+
+	assign	w_return = (M_AXI_BVALID && M_AXI_BREADY)
+			||(M_AXI_RVALID && M_AXI_RREADY);
+	// }}}
+
+	// nout
+	// {{{
+	initial	nout = 0;
+	always @(posedge i_clk)
+	if (i_reset)
+		nout <= 0;
+	else case({ w_issue, w_return })
+	2'b10: nout <= nout + 1'b1;
+	2'b01: nout <= nout - 1'b1;
+	default: begin end
+	endcase
 	// }}}
 
 	// M_AXI_AWADDR, newaddr, inc
 	// {{{
 	initial	M_AXI_AWADDR = 0;
-	initial	newaddr = 1;
+	initial	newaddr = 0;
 	always @(posedge i_clk)
 	begin
 		if (i_cmd_addr)
@@ -199,107 +569,177 @@ module	hbexecaxi #(
 				M_AXI_AWADDR <= { i_cmd_word[AW+1:2], 2'b00 }
 						+ M_AXI_AWADDR;
 			inc <= !i_cmd_word[0];
-
-			newaddr <= 1;
-		end else begin
-			if ((M_AXI_AWVALID && M_AXI_AWREADY)
-					||(M_AXI_ARVALID && M_AXI_ARREADY))
-				M_AXI_AWADDR[AW+1:2]<= M_AXI_AWADDR[AW+1:2]+(inc ? 1:0);
-
-			if (i_cmd_rd || i_cmd_wr)
-				newaddr <= 0;
-		end
+		end else if (copy_next)
+			M_AXI_AWADDR[AW+1:2] <= cp_addr;
+		else if ((M_AXI_AWVALID && M_AXI_AWREADY)
+				||(M_AXI_ARVALID && M_AXI_ARREADY))
+			// Polls always read the same address
+			M_AXI_AWADDR[AW+1:2]<= M_AXI_AWADDR[AW+1:2]
+						+((inc && !poll) ? 1:0);
 
 		M_AXI_AWADDR[1:0] <= 0;
 
-		if (i_reset)
-			newaddr <= 1;
+		// As with hbexec, any new address is echoed back to the host
+		// on the next clock, once the addition above is complete
+		newaddr <= (!i_reset)&&(i_cmd_addr);
 	end
 	// }}}
 
+	// capreq
+	// {{{
+	initial	capreq = 1'b0;
+	always @(posedge i_clk)
+		capreq <= (!i_reset)&&(i_cmd_caps);
+	// }}}
+
+	// modereq, mode
+	// {{{
+	initial	modereq = 1'b0;
+	always @(posedge i_clk)
+		modereq <= (!i_reset)&&(i_cmd_mode);
+
+	// Only those modes we support may be switched on
+	initial	mode = 2'b00;
+	always @(posedge i_clk)
+	if (i_cmd_mode)
+		mode <= i_cmd_word[5:4] & { OPT_RLE, OPT_BINARY };
+	// }}}
+
 	assign	M_AXI_ARADDR = M_AXI_AWADDR;
 	assign	M_AXI_AWPROT = 0;
 	assign	M_AXI_ARPROT = 0;
 
-	assign	o_cmd_busy = M_AXI_BREADY || M_AXI_RREADY;
-
 	// M_AXI_WDATA
 	// {{{
 	initial	M_AXI_WDATA = 0;
 	always @(posedge i_clk)
 	if (OPT_LOWPOWER && i_reset)
 		M_AXI_WDATA <= 0;
-	else if ((!OPT_LOWPOWER && !M_AXI_BREADY) ||(OPT_LOWPOWER && i_cmd_wr))
-		M_AXI_WDATA <= i_cmd_word[31:0];
-	else if (OPT_LOWPOWER && M_AXI_WREADY)
-		M_AXI_WDATA <= 0;
+	else if (!M_AXI_WVALID || M_AXI_WREADY)
+	begin
+		if (i_cmd_wr)
+			M_AXI_WDATA <= i_cmd_word[31:0];
+		else if ((burst_next)&&(fill))
+			M_AXI_WDATA <= r_args[31:0];
+		else if ((copy_next)&&(!cp_wr))
+			M_AXI_WDATA <= cp_data;
+		else if (OPT_LOWPOWER)
+			M_AXI_WDATA <= 0;
+	end
+	// }}}
+
+	// r_sel, M_AXI_WSTRB
+	// {{{
+	// The strobes for the next write command, returning to every byte once
+	// that write is issued.  Fills and copies write every byte.
+	initial	r_sel = 4'hf;
+	always @(posedge i_clk)
+	if (i_reset)
+		r_sel <= 4'hf;
+	else if (i_cmd_sel)
+		r_sel <= i_cmd_word[7:4];
+	else if (i_cmd_wr)
+		r_sel <= 4'hf;
+
+	initial	M_AXI_WSTRB = 4'hf;
+	always @(posedge i_clk)
+	if (!M_AXI_WVALID || M_AXI_WREADY)
+		M_AXI_WSTRB <= (i_cmd_wr) ? r_sel : 4'hf;
 	// }}}
 
-	assign	M_AXI_WSTRB = -1;
+	// rst_pending
+	// {{{
+	// A reset response is owed following any reset
+	initial	rst_pending = 1'b1;
+	always @(posedge i_clk)
+		rst_pending <= i_reset;
+	// }}}
 
-	// rsp_word
+	// rsp_push, rsp_word
 	// {{{
+	// Bus responses only return while requests are outstanding.  Reset,
+	// address, and capability responses are only ever generated while
+	// none are.  Hence, at most one response is generated per clock.
+	// Responses to a failed burst, to any poll read but the last, and to
+	// every request of a CRC, fill, or copy are dropped.
+	assign	w_drop = ((burst_err)&&(w_return))||(poll_miss)||(blk_drop);
+
 	always @(*)
 	begin
+		rsp_push = 1'b1;
 		rsp_word = 0;
 
-		if (M_AXI_BVALID)
+		if (rst_pending)
+			rsp_word = RSP_RESET;
+		else if (M_AXI_BVALID && M_AXI_BREADY && !w_drop)
 		begin
 			if (M_AXI_BRESP[1])
-				rsp_word[33:28] = RSP_BUS_ERROR[33:28];
+				rsp_word = RSP_BUS_ERROR;
 			else
-				rsp_word[33:32] = RSP_WRITE_ACKNOWLEDGEMENT[33:32];
-		end
-
-		if (M_AXI_RVALID)
+				rsp_word = RSP_WRITE_ACKNOWLEDGEMENT;
+		end else if (M_AXI_RVALID && M_AXI_RREADY && !w_drop)
 		begin
 			if (M_AXI_RRESP[1])
-				rsp_word[33:28] = rsp_word[33:28]
-						| RSP_BUS_ERROR[33:28];
+				rsp_word = RSP_BUS_ERROR;
 			else
-				rsp_word = rsp_word
-					| { RSP_SUB_DATA, M_AXI_RDATA };
-		end
-
-		if (newaddr)
-			rsp_word = rsp_word | { RSP_SUB_ADDR,
-					{(32-AW-2){1'b0}},
+				rsp_word = { RSP_SUB_DATA, M_AXI_RDATA };
+		end else if (argerr)
+			rsp_word = RSP_BUS_ERROR;
+		else if (blk_done)
+			rsp_word = (crc) ? { RSP_SUB_DATA, ~crc_reg }
+					: RSP_WRITE_ACKNOWLEDGEMENT;
+		else if (newaddr)
+			rsp_word = { RSP_SUB_ADDR, {(32-AW-2){1'b0}},
 					M_AXI_AWADDR[AW+1:2], 1'b0, !inc };
+		else if (capreq)
+			rsp_word = { RSP_SUB_DATA, CAPABILITIES };
+		else if (modereq)
+			rsp_word = { RSP_MODE, mode };
+		else
+			rsp_push = 1'b0;
+
+		if (OPT_LOWPOWER && !rsp_push)
+			rsp_word = 0;
 	end
 	// }}}
 
-	// o_rsp_stb, o_rsp_word
+	// ncommit
 	// {{{
-	initial	o_rsp_stb = 1'b1;
-	initial	o_rsp_word = RSP_RESET;
+	initial	ncommit = 1;
 	always @(posedge i_clk)
 	if (i_reset)
-	begin
-		o_rsp_stb <= 1'b1;
-		o_rsp_word <= RSP_RESET;
-	end else begin
-		o_rsp_stb  <= 0;
-		o_rsp_word <= 0;
-
-		if (M_AXI_BVALID || M_AXI_RVALID)
-			o_rsp_stb <= 1;
-
-		if (newaddr && (i_cmd_rd || i_cmd_wr))
-			o_rsp_stb <= 1;
+		ncommit <= 1;
+	else
+		ncommit <= ncommit
+			+ { {(LGPIPE){1'b0}}, (w_issue)||(i_cmd_addr)||(i_cmd_caps)
+							||(i_cmd_mode)||(i_cmd_crc)
+				||((w_args_done)&&(r_op != SPC_POLL))
+				||(w_arg_abort) }
+			- { {(LGPIPE){1'b0}}, rsp_pop }
+			- { {(LGPIPE){1'b0}}, w_drop }
+			- { {(LGPIPE){1'b0}}, blk_fail };
+	// }}}
 
-		o_rsp_word <= rsp_word;
+	// o_rsp_stb, o_rsp_word
+	// {{{
+	hbfifo #(.BW(CW), .LGFLEN(LGPIPE))
+	rspfifo(
+		// {{{
+		.i_clk(i_clk), .i_reset(i_reset),
+		.i_stb(rsp_push), .i_word(rsp_word), .o_full(rsp_full),
+		.o_stb(o_rsp_stb), .o_word(fifo_word), .i_busy(i_rsp_busy)
+		// }}}
+	);
 
-		if (OPT_LOWPOWER && ((!M_AXI_BVALID && !M_AXI_RVALID)
-			&& (!newaddr || (!i_cmd_rd && !i_cmd_wr))))
-			o_rsp_word <= 0;
-	end
+	assign	rsp_pop = (o_rsp_stb)&&(!i_rsp_busy);
+	assign	o_rsp_word = (OPT_LOWPOWER && !o_rsp_stb) ? 0 : fifo_word;
 	// }}}
 
 	// Make Verilator happy
 	// {{{
 	// verilator lint_off UNUSED
 	wire	unused;
-	assign	unused = &{ 1'b0, i_cmd_rd, M_AXI_BRESP[0], M_AXI_RRESP[0] };
+	assign	unused = &{ 1'b0, rsp_full, M_AXI_BRESP[0], M_AXI_RRESP[0] };
 	// verilator lint_on UNUSED
 	// }}}
 ////////////////////////////////////////////////////////////////////////////////
@@ -340,7 +780,7 @@ module	hbexecaxi #(
 	////////////////////////////////////////////////////////////////////////
 	//
 	//
-	localparam	F_LGDEPTH=2;
+	localparam	F_LGDEPTH=LGPIPE+2;
 	wire	[F_LGDEPTH-1:0]
 			faxil_awr_outstanding, faxil_wr_outstanding,
 			faxil_rd_outstanding;
@@ -376,32 +816,51 @@ module	hbexecaxi #(
 	always @(*)
 		assert(!M_AXI_BREADY || !M_AXI_RREADY);
 
+	// Every request issued is either waiting to be accepted, or counted
+	// by the bus properties as outstanding
 	always @(*)
-	if (!M_AXI_BREADY)
+	if (nout == 0 || !wr)
 	begin
 		assert(faxil_awr_outstanding == 0);
 		assert(faxil_wr_outstanding  == 0);
 		assert(M_AXI_AWVALID == 0);
 		assert(M_AXI_WVALID  == 0);
 	end else begin
-		assert(faxil_awr_outstanding == (M_AXI_AWVALID ? 0:1));
-		assert(faxil_wr_outstanding  == (M_AXI_WVALID  ? 0:1));
+		assert(faxil_awr_outstanding + (M_AXI_AWVALID ? 1:0) == nout);
+		assert(faxil_wr_outstanding  + (M_AXI_WVALID  ? 1:0) == nout);
 	end
 
 	always @(*)
-	if (!M_AXI_RREADY)
+	if (nout == 0 || wr)
 	begin
 		assert(faxil_rd_outstanding == 0);
 		assert(M_AXI_ARVALID == 0);
 	end else
-		assert(faxil_rd_outstanding == (M_AXI_ARVALID ? 0:1));
+		assert(faxil_rd_outstanding + (M_AXI_ARVALID ? 1:0) == nout);
+
+	always @(*)
+		assert(nout <= PIPEDEPTH);
+
+	always @(*)
+	if ((burst)&&(nout != 0))
+		assert(wr == fill);
+
+	// Polls issue one read at a time, once their arguments have arrived
+	always @(*)
+	if (poll)
+	begin
+		assert(!wr);
+		assert(!burst);
+		assert(nargs == 0);
+		assert(nout <= 1);
+	end
 
 	always @(posedge i_clk)
 	if ((!f_past_valid)||($past(i_reset)))
 	begin
 		`ASSUME(!i_cmd_stb);
-		assert(!M_AXI_BREADY);
-		assert(!M_AXI_RREADY);
+		assert(nout == 0);
+		assert(rst_pending);
 	end
 
 	always @(*)
@@ -424,9 +883,6 @@ module	hbexecaxi #(
 	////////////////////////////////////////////////////////////////////////
 	//
 	//
-	always @(*)
-		assert(o_cmd_busy == (M_AXI_BREADY || M_AXI_RREADY));
-
 	always @(posedge i_clk)
 	if (!f_past_valid || $past(i_reset))
 	begin
@@ -445,6 +901,77 @@ module	hbexecaxi #(
 	//
 	//
 
+	// f_rsp_fill, the number of responses waiting in the response FIFO
+	reg	[LGPIPE:0]	f_rsp_fill;
+
+	initial	f_rsp_fill = 0;
+	always @(posedge i_clk)
+	if (i_reset)
+		f_rsp_fill <= 0;
+	else case({ (rsp_push)&&(!rsp_full), rsp_pop })
+	2'b10: f_rsp_fill <= f_rsp_fill + 1'b1;
+	2'b01: f_rsp_fill <= f_rsp_fill - 1'b1;
+	default: begin end
+	endcase
+
+	always @(*)
+		assert(o_rsp_stb == (f_rsp_fill != 0));
+
+	// The response FIFO never overflows
+	always @(*)
+	if (rsp_push)
+		assert(!rsp_full);
+
+	always @(*)
+	begin
+		assert(ncommit <= PIPEDEPTH);
+		assert(ncommit == f_rsp_fill + nout
+				+ { {(LGPIPE){1'b0}}, newaddr }
+				+ { {(LGPIPE){1'b0}}, capreq }
+				+ { {(LGPIPE){1'b0}}, modereq }
+				+ { {(LGPIPE){1'b0}}, blk }
+				+ { {(LGPIPE){1'b0}}, rst_pending }
+				+ { {(LGPIPE){1'b0}}, argerr });
+	end
+
+	always @(*)
+	begin
+		assert(crc + fill + copy + poll <= 1);
+		if ((crc)||(fill))
+			assert((burst)&&(!burst_err));
+		if (copy)
+			assert((!burst)&&(nout <= 1));
+	end
+
+	// Address, capability, mode, and reset responses are only generated
+	// while nothing is outstanding
+	always @(*)
+	if (newaddr || capreq || modereq || rst_pending || argerr)
+		assert(nout == 0);
+
+	// A special waiting on its arguments is never overwritten by another
+	// command, and nothing else happens until they arrive
+	always @(posedge i_clk)
+	if ((f_past_valid)&&(!$past(i_reset))&&($past(nargs != 0))
+			&&(nargs != 0))
+		assert($stable(r_op));
+
+	always @(*)
+	if (nargs != 0)
+	begin
+		assert((nout == 0)&&(!burst)&&(!poll)&&(!blk));
+		assert((!newaddr)&&(!capreq)&&(!modereq)&&(!argerr));
+		assert((r_op == SPC_POLL)||(r_op == SPC_FILL)
+				||(r_op == SPC_COPY));
+	end
+
+	always @(*)
+	if ((argerr)&&(!rst_pending))
+		assert((rsp_push)&&(rsp_word == RSP_BUS_ERROR));
+
+	always @(*)
+	if (burst_err)
+		assert(burst && burst_count == 0);
 	// }}}
 	////////////////////////////////////////////////////////////////////////
 	//
@@ -479,76 +1006,81 @@ module	hbexecaxi #(
 	// {{{
 	always @(posedge i_clk)
 	if (!f_past_valid || $past(i_reset))
-		assert(newaddr);
-	else if ($past(i_cmd_addr))
-		assert(newaddr);
-	else if ($past(i_cmd_rd || i_cmd_wr))
 		assert(!newaddr);
 	else
-		assert($stable(newaddr));
+		assert(newaddr == $past(i_cmd_addr));
+	// }}}
+
+	// Any new address is echoed back on the next clock
+	// {{{
+	always @(*)
+	if (newaddr && !rst_pending)
+		`ASSERT(rsp_push && rsp_word == { RSP_SUB_ADDR, {(30-AW){1'b0}},
+				M_AXI_AWADDR[AW+1:2], 1'b0, !inc });
 	// }}}
 
-	// Following any command for a read or write, any pending new address
-	// gets flushed to the outgoing stream
+	// As is the answer to any capability query
 	// {{{
 	always @(posedge i_clk)
-	if ((f_past_valid)&&(!$past(i_reset))&&($past(i_cmd_rd || i_cmd_wr)))
-	begin
-		`ASSERT(o_rsp_stb  == $past(newaddr));
-		if ($past(newaddr))
-			`ASSERT(o_rsp_word == { RSP_SUB_ADDR, {(30-AW){1'b0}},
-				$past(M_AXI_AWADDR[AW+1:1]), !$past(inc) });
-	end
+	if (f_past_valid && !$past(i_reset) && $past(i_cmd_caps))
+		`ASSERT(capreq && rsp_push
+			&& rsp_word == { RSP_SUB_DATA, CAPABILITIES });
 	// }}}
 
-	// The new address flag must be low while any request is pending
+	// And to any mode switch
 	// {{{
-	always @(*)
-	if (!i_reset && (M_AXI_BREADY || M_AXI_RREADY))
-		assert(!newaddr);
+	always @(posedge i_clk)
+	if (f_past_valid && !$past(i_reset) && $past(i_cmd_mode))
+		`ASSERT(modereq && rsp_push
+			&& rsp_word == { RSP_MODE,
+				$past(i_cmd_word[5:4]) & { OPT_RLE, OPT_BINARY } });
 	// }}}
 
 	// A reset return follows immediately following any reset
 	// {{{
-	always @(posedge i_clk)
-	if ((f_past_valid)&&($past(i_reset)))
-		`ASSERT((o_rsp_stb)&&(o_rsp_word == RSP_RESET));
+	always @(*)
+	if (rst_pending)
+		`ASSERT((rsp_push)&&(rsp_word == RSP_RESET));
 	// }}}
 
-	// Wirte responses follow any valid write return
+	// Write responses follow any valid write return
 	// {{{
-	always @(posedge i_clk)
-	if (f_past_valid && !$past(i_reset)
-			&& $past(M_AXI_BVALID && !M_AXI_BRESP[1]))
+	always @(*)
+	if (!i_reset && M_AXI_BVALID && !M_AXI_BRESP[1])
 	begin
-		assert(o_rsp_stb);
-		assert(o_rsp_word == RSP_WRITE_ACKNOWLEDGEMENT);
+		assert(rsp_push);
+		assert(rsp_word == RSP_WRITE_ACKNOWLEDGEMENT);
 	end
 	// }}}
 
 	// Read value responses follow any returned read value
 	// {{{
-	always @(posedge i_clk)
-	if (f_past_valid && !$past(i_reset)
-			&& $past(M_AXI_RVALID && !M_AXI_RRESP[1]))
+	always @(*)
+	if (!i_reset && M_AXI_RVALID && !M_AXI_RRESP[1] && !w_drop)
 	begin
-		assert(o_rsp_stb);
-		assert(o_rsp_word == { RSP_SUB_DATA, $past(M_AXI_RDATA) });
+		assert(rsp_push);
+		assert(rsp_word == { RSP_SUB_DATA, M_AXI_RDATA });
 	end
 	// }}}
 
 	// Bus error responses follow any form of bus error
 	// {{{
-	always @(posedge i_clk)
-	if (f_past_valid && (!$past(i_reset))
-		&&(($past(M_AXI_BVALID && M_AXI_BRESP[1]))
-			||($past(M_AXI_RVALID && M_AXI_RRESP[1]))))
+	always @(*)
+	if (!i_reset && ((M_AXI_BVALID && M_AXI_BRESP[1])
+			||(M_AXI_RVALID && M_AXI_RRESP[1] && !w_drop)))
 	begin
-		assert(o_rsp_stb);
-		assert(o_rsp_word == RSP_BUS_ERROR);
+		assert(rsp_push);
+		assert(rsp_word == RSP_BUS_ERROR);
 	end
 	// }}}
 
+	// Responses to a burst that's already failed are dropped
+	// {{{
+	always @(*)
+	if (!i_reset && M_AXI_RVALID && burst_err)
+		assert(!rsp_push);
+	// }}}
+
 	// }}}
 	////////////////////////////////////////////////////////////////////////
 	//
@@ -604,6 +1136,19 @@ module	hbexecaxi #(
 
 	always @(posedge i_clk)
 		cover(cvr_reads == 4 && faxil_rd_outstanding == 0);
+
+	// Several reads outstanding at once
+	always @(posedge i_clk)
+		cover(faxil_rd_outstanding > 2);
+
+	// Several writes outstanding at once
+	always @(posedge i_clk)
+		cover(faxil_awr_outstanding > 2 && faxil_wr_outstanding > 2);
+
+	// A burst read, completed
+	always @(posedge i_clk)
+	if (f_past_valid && !$past(i_reset))
+		cover($fell(burst) && cvr_reads >= 3);
 	// }}}
 `endif
 // }}}
@@ -0,0 +1,202 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	hbfifo.v
+// {{{
+// Project:	dbgbus, a collection of 8b channel to WB bus debugging protocols
+//
+// Purpose:	A command FIFO, placed between hbpack and hbexec.  hbpack
+//		produces command words as they arrive, with no way of being
+//	stalled, whereas hbexec can only accept a new command once the last
+//	has completed and the return channel is ready for its response.  This
+//	FIFO holds up to 2^LGFLEN commands in between, so that a host may send
+//	that many commands without waiting on any of their responses.  Any
+//	command arriving while the FIFO is full is dropped.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2017-2024, Gisselquist Technology, LLC
+// {{{
+// This file is part of the hexbus debugging interface.
+//
+// The hexbus interface is free software (firmware): you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// The hexbus interface is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  (It's in the $(ROOT)/doc directory.  Run make
+// with no target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	LGPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/lgpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+`default_nettype	none
+// }}}
+module	hbfifo #(
+		// {{{
+		parameter	BW=34,		// Bits per command word
+		parameter	LGFLEN=4	// Log_2 of the FIFO depth
+		// }}}
+	) (
+		// {{{
+		input	wire			i_clk, i_reset,
+		// Commands from hbpack
+		input	wire			i_stb,
+		input	wire	[(BW-1):0]	i_word,
+		output	wire			o_full,
+		// Commands to hbexec
+		output	wire			o_stb,
+		output	wire	[(BW-1):0]	o_word,
+		input	wire			i_busy
+		// }}}
+	);
+
+	// Local declarations
+	// {{{
+	reg	[(BW-1):0]	mem	[0:((1<<LGFLEN)-1)];
+	reg	[LGFLEN:0]	wr_addr, rd_addr;
+	wire			w_wr, w_rd;
+	// }}}
+
+	assign	w_wr = (i_stb)&&(!o_full);
+	assign	w_rd = (o_stb)&&(!i_busy);
+
+	// wr_addr, mem
+	// {{{
+	initial	wr_addr = 0;
+	always @(posedge i_clk)
+	if (i_reset)
+		wr_addr <= 0;
+	else if (w_wr)
+		wr_addr <= wr_addr + 1'b1;
+
+	always @(posedge i_clk)
+	if (w_wr)
+		mem[wr_addr[(LGFLEN-1):0]] <= i_word;
+	// }}}
+
+	// rd_addr
+	// {{{
+	initial	rd_addr = 0;
+	always @(posedge i_clk)
+	if (i_reset)
+		rd_addr <= 0;
+	else if (w_rd)
+		rd_addr <= rd_addr + 1'b1;
+	// }}}
+
+	// The FIFO is full when the write pointer has wrapped once more than
+	// the read pointer, and empty when the two are equal.
+	assign	o_full = (wr_addr[LGFLEN] != rd_addr[LGFLEN])
+			&&(wr_addr[(LGFLEN-1):0] == rd_addr[(LGFLEN-1):0]);
+	assign	o_stb  = (wr_addr != rd_addr);
+	assign	o_word = mem[rd_addr[(LGFLEN-1):0]];
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//
+// Formal properties
+// {{{
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+`ifdef	FORMAL
+`ifdef	HBFIFO
+`define	ASSUME	assume
+`define	ASSERT	assert
+`else
+`define	ASSUME	assert
+`define	ASSERT	assert
+`endif
+	reg		f_past_valid;
+	wire	[LGFLEN:0]	f_fill;
+
+	initial	f_past_valid = 1'b0;
+	always @(posedge i_clk)
+		f_past_valid <= 1'b1;
+
+	always @(*)
+	if (!f_past_valid)
+		`ASSUME(i_reset);
+
+	assign	f_fill = wr_addr - rd_addr;
+
+	always @(*)
+		`ASSERT(f_fill <= (1<<LGFLEN));
+
+	always @(*)
+		`ASSERT(o_full == (f_fill == (1<<LGFLEN)));
+
+	always @(*)
+		`ASSERT(o_stb == (f_fill != 0));
+
+	// Once offered, a command stays offered until it is taken
+	always @(posedge i_clk)
+	if ((f_past_valid)&&(!$past(i_reset))&&($past(o_stb))&&($past(i_busy)))
+		`ASSERT((o_stb)&&($stable(o_word)));
+
+	// A command written into an empty FIFO is the next one read out
+	(* anyconst *)	reg	[(BW-1):0]	f_word;
+	reg	f_tracking;
+
+	initial	f_tracking = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+		f_tracking <= 1'b0;
+	else if ((w_wr)&&(!o_stb)&&(i_word == f_word))
+		f_tracking <= 1'b1;
+	else if (w_rd)
+		f_tracking <= 1'b0;
+
+	always @(*)
+	if (f_tracking)
+		`ASSERT((o_stb)&&(o_word == f_word));
+
+`ifdef	HBFIFO
+	// The host's credit rule: it never has more commands outstanding than
+	// the FIFO holds.  A command remains outstanding until the host hears
+	// the response to it, or to some later command.  That can only happen
+	// once the command has left the FIFO, so the host may only count as
+	// answered those commands already read out.  Under this rule, the
+	// FIFO never overflows.
+	(* anyseq *)	reg	f_answered;
+	reg	[LGFLEN:0]	f_outstanding;
+
+	initial	f_outstanding = 0;
+	always @(posedge i_clk)
+	if (i_reset)
+		f_outstanding <= 0;
+	else
+		f_outstanding <= f_outstanding + { {(LGFLEN){1'b0}}, i_stb }
+				- { {(LGFLEN){1'b0}}, f_answered };
+
+	always @(*)
+	if (f_answered)
+		assume(f_outstanding > f_fill);
+
+	always @(*)
+	if (i_stb)
+		assume(f_outstanding < (1<<LGFLEN));
+
+	always @(*)
+		assert(f_fill <= f_outstanding);
+
+	always @(*)
+	if (i_stb)
+		assert(!o_full);
+`endif
+`endif
+// }}}
+endmodule
@@ -21,6 +21,8 @@
 //	5'h14	-> I	(Interrupt)
 //	5'h15	-> Z	(IDLE)
 //	5'h16	-> T	(Reset)
+//	5'h1c	-> M	(Mode switch, see hbbinenc)
+//	5'h1d	-> D	(Repeat the last read, see hbrle)
 //
 //	All others characters will cause a carriage return, newline pair
 //	to be sent, with the exception that duplicate carriage return, newlin
@@ -114,6 +116,9 @@ module	hbgenhex (
 	5'h19: w_gx_char = "E";	// BUS Error
 	5'h1a: w_gx_char = "I";	// Interrupt
 	5'h1b: w_gx_char = "Z";	// Zzzz -- I'm here, but sleeping
+	5'h1c: w_gx_char = "M";	// Mode switch
+	5'h1d: w_gx_char = "D";	// Duplicate the last read, N times
+	5'h1e: w_gx_char = "V";	// Interrupt vector
 	default: w_gx_char = 8'hd;	// Carriage return
 	endcase
 	// }}}
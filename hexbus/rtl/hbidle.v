@@ -40,11 +40,14 @@
 //
 `define	IDLE_SUB_WORD	5'b11011
 `define	IDLE_WORD	{ `IDLE_SUB_WORD, {(34-5){1'b0}} }
+`define	LOST_WORD	{ 2'b11, 3'h1, 29'h00 }	// A bus error
 //
 // }}}
 module	hbidle (
 		// {{{
 		input	wire		i_clk, i_reset,
+		// A command was lost, since the command FIFO was full
+		input	wire		i_lost,
 		//
 		input	wire		i_cmd_stb,
 		input	wire	[33:0]	i_cmd_word,
@@ -61,7 +64,8 @@ module	hbidle (
 	// If our bus has been idle for a long time, then set an idle_stb, so
 	// that we can send a message back just to say that we are alive.
 	//
-	reg		idle_stb;
+	reg		idle_stb, lost_pending;
+	wire		lost_load;
 `ifdef	VERILATOR
 	reg	[22:0]	idle_counter;
 `else
@@ -82,12 +86,31 @@ module	hbidle (
 		{ idle_stb, idle_counter } <= idle_counter + 1'b1;
 	// }}}
 
+	// lost_pending, lost_load
+	// {{{
+	// Should a command be lost, its response--and that of anything
+	// waiting on it--will never come.  Rather than leave the host waiting
+	// on them, we tell it with a bus error, ahead of any other response.
+	initial	lost_pending = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+		lost_pending <= 1'b0;
+	else if (i_lost)
+		lost_pending <= 1'b1;
+	else if (lost_load)
+		lost_pending <= 1'b0;
+
+	assign	lost_load = (lost_pending)&&((!o_idl_stb)||(!i_busy));
+	// }}}
+
 	// o_idl_stb
 	// {{{
 	initial	o_idl_stb = 1'b0;
 	always @(posedge i_clk)
 	if (i_reset)
 		o_idl_stb <= 1'b0;
+	else if (lost_load)
+		o_idl_stb <= 1'b1;
 	else if ((i_cmd_stb)&&(!o_idl_busy))
 		o_idl_stb <= 1'b1;
 	else if ((idle_stb)&&(!o_idl_stb))
@@ -100,13 +123,15 @@ module	hbidle (
 	// {{{
 	initial	o_idl_word = `IDLE_WORD;
 	always @(posedge i_clk)
-	if ((i_cmd_stb)&&(!o_idl_busy))
+	if (lost_load)
+		o_idl_word <= `LOST_WORD;
+	else if ((i_cmd_stb)&&(!o_idl_busy))
 		o_idl_word <= i_cmd_word;
 	else if (!i_busy)
 		o_idl_word <= `IDLE_WORD;
 	// }}}
 
-	assign	o_idl_busy = (o_idl_stb)&&(i_busy);
+	assign	o_idl_busy = ((o_idl_stb)&&(i_busy))||(lost_pending);
 
 endmodule
 
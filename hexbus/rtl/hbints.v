@@ -4,7 +4,14 @@
 // {{{
 // Project:	dbgbus, a collection of 8b channel to WB bus debugging protocols
 //
-// Purpose:	
+// Purpose:	Inserts interrupt notifications into the response stream.
+//		With a single interrupt line (NINTS == 1), a rising interrupt
+//	is reported with an 'I' alone.  With more, each report is instead a 'V'
+//	followed by a vector of every line that has risen since the last
+//	report, so that the host needn't read anything to learn which it was.
+//	Each line is only reported again once it has dropped, and risen anew.
+//	There are only 29 bits following the code of any response word, so
+//	there may be at most 29 lines.
 //
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
@@ -38,10 +45,14 @@
 //
 `default_nettype	none
 // }}}
-module	hbints(
+module	hbints #(
+		// {{{
+		parameter	NINTS = 1
+		// }}}
+	) (
 		// {{{
 		input	wire		i_clk, i_reset,
-		input	wire		i_interrupt,
+		input	wire	[NINTS-1:0]	i_interrupt,
 		//
 		input	wire		i_stb,
 		input	wire	[33:0]	i_word,
@@ -55,33 +66,44 @@ module	hbints(
 
 	// Local declarations
 	// {{{
-	localparam [4:0]	INT_PREFIX = 5'b11010;
+	// 5'h1a is an 'I', 5'h1e a 'V'
+	localparam [4:0]	INT_PREFIX = (NINTS > 1) ? 5'b11110 : 5'b11010;
 	localparam [33:0]	INT_WORD = { INT_PREFIX, {(34-5){1'b0}} };
-	reg	int_state, pending_interrupt, loaded, int_loaded;
+	reg	[NINTS-1:0]	int_state, pending;
+	wire	[NINTS-1:0]	int_sent;
+	wire			pending_interrupt;
+	reg	loaded, int_loaded;
 	// }}}
 
 	// int_state
 	// {{{
-	initial	int_state = 1'b0;
+	// A line remains set here from when it rises until it has both been
+	// reported and dropped
+	initial	int_state = 0;
 	always @(posedge i_clk)
 	if (i_reset)
-		int_state <= 1'b0;
-	else if ((i_interrupt)&&(!int_state))
-		int_state <= 1'b1;
-	else if ((!pending_interrupt)&&(!i_interrupt))
-		int_state <= 1'b0;
+		int_state <= 0;
+	else
+		int_state <= i_interrupt | (int_state & pending);
 	// }}}
 
-	// pending_interrupt
+	// pending, pending_interrupt
 	// {{{
-	initial	pending_interrupt = 1'b0;
+	// Lines that have risen, but not yet been reported.  Only those lines
+	// in the word sent are cleared once it's accepted--any that rose
+	// since it was loaded will go in the next.
+	assign	int_sent = ((o_int_stb)&&(!i_busy)&&(int_loaded))
+			? ((NINTS > 1) ? o_int_word[NINTS-1:0] : {(NINTS){1'b1}})
+			: 0;
+
+	initial	pending = 0;
 	always @(posedge i_clk)
 	if (i_reset)
-		pending_interrupt <= 1'b0;
-	else if ((i_interrupt)&&(!int_state))
-		pending_interrupt <= 1'b1;
-	else if ((o_int_stb)&&(!i_busy)&&(int_loaded))
-		pending_interrupt <= 1'b0;
+		pending <= 0;
+	else
+		pending <= (pending & ~int_sent) | (i_interrupt & ~int_state);
+
+	assign	pending_interrupt = (pending != 0);
 	// }}}
 
 	// loaded
@@ -104,7 +126,10 @@ module	hbints(
 		o_int_stb <= 1'b0;
 	else if ((i_stb)&&(!o_int_busy))
 		o_int_stb <= 1'b1;
-	else if ((pending_interrupt)&&((!int_loaded)||(i_busy)))
+	else if ((pending_interrupt)
+			&&((!o_int_stb)||(!int_loaded)||(i_busy)))
+		// Offer any pending interrupt at once, unless we've just
+		// sent one, even if the link is otherwise idle
 		o_int_stb <= 1'b1;
 	else if ((!loaded)||(!i_busy))
 		o_int_stb <= 1'b0;
@@ -121,8 +146,11 @@ module	hbints(
 		o_int_word <= i_word;
 	end else if ((!i_busy)||(!o_int_stb))
 	begin
-		// Send an interrupt
+		// Send an interrupt, together with the lines pending if
+		// there's more than one
 		o_int_word <= INT_WORD;
+		if (NINTS > 1)
+			o_int_word[NINTS-1:0] <= pending;
 		int_loaded <= 1'b1;
 	end
 	// }}}
@@ -156,8 +184,11 @@ module	hbints(
 	if ((f_past_valid)&&(!$past(i_reset))&&($past(i_stb))&&($past(o_int_busy)))
 		`ASSUME(($stable(i_stb))&&($stable(i_word)));
 
+	always @(*)
+		`ASSERT(NINTS <= 29);
+
 	always @(posedge i_clk)
-	if ((f_past_valid)&&(!$past(i_reset))&&($past(i_busy))&&($past(o_int_word != INT_WORD))
+	if ((f_past_valid)&&(!$past(i_reset))&&($past(i_busy))&&(!$past(int_loaded))
 			&&($past(o_int_stb)))
 		`ASSERT(($stable(o_int_stb))&&($stable(o_int_word)));
 
@@ -166,7 +197,7 @@ module	hbints(
 		`ASSERT((o_int_stb)&&(o_int_word == $past(i_word)));
 
 	always @(posedge i_clk)
-	if ((f_past_valid)&&(!$past(i_reset))&&(o_int_word != INT_WORD))
+	if ((f_past_valid)&&(!$past(i_reset))&&(!int_loaded))
 		`ASSERT((!o_int_stb)||(loaded));
 
 	always @(*)
@@ -175,16 +206,27 @@ module	hbints(
 
 	always @(*)
 	if (i_stb)
-		`ASSUME(i_word != INT_WORD);
+		`ASSUME(i_word[33:29] != INT_PREFIX);
 
 	// If we just sent an interrupt signal, then don't send another
 	always @(posedge i_clk)
-	if((f_past_valid)&&($past(o_int_stb))&&($past(o_int_word == INT_WORD))
+	if((f_past_valid)&&($past(o_int_stb))&&($past(int_loaded))
 				&&(!$past(i_busy)))
-		`ASSERT((!o_int_stb)||(o_int_word != INT_WORD));
+		`ASSERT((!o_int_stb)||(!int_loaded));
+
+	always @(*)
+		`ASSERT(int_loaded == (o_int_word[33:29] == INT_PREFIX));
+
+	// A pending interrupt never waits on the link to be busy
+	always @(posedge i_clk)
+	if ((f_past_valid)&&(!$past(i_reset))&&($past(pending_interrupt))
+			&&(!$past(o_int_stb)))
+		`ASSERT(o_int_stb);
 
+	// Only lines that are pending are ever reported
 	always @(*)
-		`ASSERT(int_loaded == (o_int_word == INT_WORD));
+	if ((NINTS > 1)&&(o_int_stb)&&(int_loaded))
+		`ASSERT((o_int_word[NINTS-1:0] & ~pending) == 0);
 	/*
 	reg	f_state;
 	always @(posedge i_clk)
@@ -0,0 +1,237 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	hbrle.v
+// {{{
+// Project:	dbgbus, a collection of 8b channel to WB bus debugging protocols
+//
+// Purpose:	Compresses runs of identical read responses.  Scope buffers,
+//		sparse traces, and cleared memories are full of the same word,
+//	over and over again.  Rather than sending every copy back to the host,
+//	this sends the first, and then counts how many more copies follow.
+//	The count is then sent in place of those copies, as a single repeat
+//	response:
+//
+//		{ 2'b11, 3'h5, 1'b0, count[27:0] }
+//
+//	meaning "repeat the last read response count more times".  This is
+//	sent as a 'D' followed by eight hexadecimal digits, or as an ESC D
+//	followed by four bytes in binary.
+//
+//	Copies are only counted while the return channel is busy sending
+//	something else, so this never holds a response back from an otherwise
+//	idle channel--but a long burst from a slow link will be compressed
+//	almost entirely.  Any other response first flushes the count.  A
+//	count of one is sent as the copy itself: a repeat costs as much as a
+//	read response in hexadecimal, and more in binary, where it also ends
+//	the run of read responses sent without their ESC R.
+//
+//	Compression is off following any reset, and is turned on or off by the
+//	mode switch response (see hbexec) as it passes through.  Since the host
+//	must ask for it, a human at a terminal won't see any repeats.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2017-2024, Gisselquist Technology, LLC
+// {{{
+// This file is part of the hexbus debugging interface.
+//
+// The hexbus interface is free software (firmware): you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// The hexbus interface is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  (It's in the $(ROOT)/doc directory.  Run make
+// with no target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	LGPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/lgpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+`default_nettype	none
+// }}}
+module	hbrle (
+		// {{{
+		input	wire		i_clk, i_reset,
+		// Responses, from hbexec
+		input	wire		i_stb,
+		input	wire	[33:0]	i_word,
+		output	wire		o_busy,
+		// Responses, on to hbints
+		output	reg		o_stb,
+		output	reg	[33:0]	o_word,
+		input	wire		i_busy
+		// }}}
+	);
+
+	// Local declarations
+	// {{{
+	localparam [1:0]	RSP_SUB_DATA = 2'b00;
+	localparam [4:0]	RSP_MODE   = 5'b11100,
+				RSP_REPEAT = 5'b11101;
+
+	reg		r_rle, r_valid;
+	reg	[31:0]	r_last;
+	reg	[27:0]	r_count;
+	wire		w_ready, w_repeat, w_pass;
+	// }}}
+
+	// w_ready is true if the output register may be loaded.  w_repeat is
+	// true if the incoming word is a copy of the last read response sent,
+	// and so may be counted rather than sent.  w_pass is true when any
+	// other word is passed on.
+	assign	w_ready  = (!o_stb)||(!i_busy);
+	assign	w_repeat = (i_stb)&&(r_rle)&&(r_valid)
+			&&(i_word[33:32] == RSP_SUB_DATA)
+			&&(i_word[31:0] == r_last)&&(!(&r_count));
+	assign	w_pass   = (i_stb)&&(!w_repeat)&&(w_ready)&&(r_count == 0);
+
+	// Repeats may be accepted at any time.  Anything else waits for the
+	// count to be flushed, and then for room in the output register.
+	assign	o_busy = (!w_repeat)&&((!w_ready)||(r_count != 0));
+
+	// r_rle
+	// {{{
+	initial	r_rle = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+		r_rle <= 1'b0;
+	else if ((w_pass)&&(i_word[33:29] == RSP_MODE))
+		r_rle <= i_word[1];
+	// }}}
+
+	// r_valid, r_last
+	// {{{
+	// The last word sent, if it was a read response
+	initial	r_valid = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+		r_valid <= 1'b0;
+	else if (w_pass)
+		r_valid <= (i_word[33:32] == RSP_SUB_DATA);
+
+	always @(posedge i_clk)
+	if (w_pass)
+		r_last <= i_word[31:0];
+	// }}}
+
+	// r_count
+	// {{{
+	// The count is flushed as soon as there's room to send it.  Any
+	// repeat arriving at the same time then starts the next count.
+	initial	r_count = 0;
+	always @(posedge i_clk)
+	if (i_reset)
+		r_count <= 0;
+	else if ((w_ready)&&(r_count != 0))
+		r_count <= (w_repeat) ? 28'h1 : 28'h0;
+	else if (w_repeat)
+		r_count <= r_count + 1'b1;
+	// }}}
+
+	// o_stb, o_word
+	// {{{
+	initial	o_stb = 1'b0;
+	always @(posedge i_clk)
+	if (i_reset)
+		o_stb <= 1'b0;
+	else if (w_ready)
+		o_stb <= (r_count != 0)||(w_pass);
+
+	always @(posedge i_clk)
+	if (w_ready)
+	begin
+		if (r_count == 1)
+			o_word <= { RSP_SUB_DATA, r_last };
+		else if (r_count != 0)
+			o_word <= { RSP_REPEAT, 1'b0, r_count };
+		else
+			o_word <= i_word;
+	end
+	// }}}
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//
+// Formal properties
+// {{{
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+`ifdef	FORMAL
+`ifdef	HBRLE
+`define	ASSUME	assume
+`define	ASSERT	assert
+`else
+`define	ASSUME	assert
+`define	ASSERT	assert
+`endif
+	reg	f_past_valid;
+
+	initial	f_past_valid = 1'b0;
+	always @(posedge i_clk)
+		f_past_valid <= 1'b1;
+
+	always @(*)
+	if (!f_past_valid)
+		`ASSUME(i_reset);
+
+	always @(posedge i_clk)
+	if ((f_past_valid)&&(!$past(i_reset))&&($past(i_stb))&&($past(o_busy)))
+		`ASSUME(($stable(i_stb))&&($stable(i_word)));
+
+	// Repeats are only ever generated here
+	always @(*)
+	if (i_stb)
+		`ASSUME(i_word[33:29] != RSP_REPEAT);
+
+	// Once offered, a word stays offered until it is taken
+	always @(posedge i_clk)
+	if ((f_past_valid)&&(!$past(i_reset))&&($past(o_stb))&&($past(i_busy)))
+		`ASSERT((o_stb)&&($stable(o_word)));
+
+	// Only a read response, while compressing, may be repeated
+	always @(*)
+	if (r_count != 0)
+		`ASSERT((r_rle)&&(r_valid));
+
+	// Every word is either counted, or passed on
+	always @(posedge i_clk)
+	if ((f_past_valid)&&(!$past(i_reset))&&($past(w_pass)))
+		`ASSERT((o_stb)&&(o_word == $past(i_word)));
+
+	always @(posedge i_clk)
+	if ((f_past_valid)&&(!$past(i_reset))&&($past(w_repeat))
+			&&((!$past(w_ready))||($past(r_count) == 0)))
+		`ASSERT(r_count == $past(r_count) + 1'b1);
+
+	// A repeat is only sent for two or more copies.  A single copy is
+	// sent as itself.
+	always @(posedge i_clk)
+	if ((f_past_valid)&&(!$past(i_reset))&&($past(w_ready))
+			&&($past(r_count) != 0))
+	begin
+		`ASSERT(o_stb);
+		if ($past(r_count) == 1)
+			`ASSERT(o_word == { RSP_SUB_DATA, $past(r_last) });
+		else
+			`ASSERT(o_word == { RSP_REPEAT, 1'b0, $past(r_count) });
+	end
+
+	always @(*)
+	if ((o_stb)&&(o_word[33:29] == RSP_REPEAT))
+		`ASSERT(o_word[27:0] > 1);
+`endif
+// }}}
+endmodule
@@ -0,0 +1,397 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	binbus.cpp
+// {{{
+// Project:	dbgbus, a collection of 8b channel to WB bus debugging protocols
+//
+// Purpose:	The binary form of the hexbus protocol.  This includes the
+//		binary halves of the HEXENCODER and HEXDECODER, and the BINBUS,
+//	which switches the FPGA to binary, and to compressed read responses,
+//	once it knows the FPGA supports them.
+//
+//	Commands are sent as frames, each starting with a header byte:
+//
+//	0x80		Read
+//	0xa0 | (n-1)	Write n words (1 <= n <= 32), followed by 4n bytes
+//	0xc0 | n	Address, followed by n bytes (n <= 4)
+//	0xe0 | n	Special command, followed by n bytes (n <= 4)
+//
+//	All values are sent most significant byte first, with any leading zero
+//	bytes dropped.  Responses start with an escape (0x1b), followed by the
+//	same letter as would start them in hexadecimal.  Read ('R') responses
+//	are followed by four bytes of data, and may be followed by further
+//	read responses--four bytes each--without any further escapes.  An
+//	address ('A') is also followed by four bytes, as are the count of a
+//	repeat ('D') and an interrupt vector ('V').  Any escape within these bytes is sent twice.  See hbbindec.v and hbbinenc.v for the FPGA side.
+//
+//	This code does not run on an FPGA, is not a test bench, neither is it a
+//	simulator.  It is a portion of a command program for commanding an FPGA.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2017-2024, Gisselquist Technology, LLC
+// {{{
+// This file is part of the hexbus debugging interface.
+//
+// The hexbus interface is free software (firmware): you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// The hexbus interface is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  (It's in the $(ROOT)/doc directory.  Run make
+// with no target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	LGPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/lgpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <string.h>
+
+#include "binbus.h"
+
+#define	BINB_ESC	0x1b
+
+// Frame headers
+#define	BINB_READ	0x80
+#define	BINB_WRITE	0xa0
+// The most words a single write frame may carry
+#define	BINB_MAXWRITE	32
+
+// See the note in hexbus.cpp
+#ifndef	DBGPRINTF
+#define	DBGPRINTF	null
+#endif
+extern	void	null(...);
+
+/*
+ * HEXENCODER::binpace
+ *
+ * As with pace(), pad the frame starting at start out to m_pace bytes.  The
+ * FPGA ignores anything other than a header, or a 'T', between frames, so
+ * newlines may be used here as well.  Frames need no terminator, though, so
+ * nothing is added once the pace is zero.
+ */
+void	HEXENCODER::binpace(unsigned start) {
+	while(m_len - start < m_pace)
+		m_buf[m_len++] = '\n';
+	m_buf[m_len] = '\0';
+}
+
+/*
+ * HEXENCODER::frame
+ *
+ * Append an address or special frame, with as few bytes as will hold v.
+ */
+void	HEXENCODER::frame(unsigned hdr, unsigned v) {
+	unsigned	start = m_len, n = (hexlen(v)+1) >> 1;
+
+	reserve(5 + m_pace);
+	m_buf[m_len++] = hdr | n;
+	while(n > 0) {
+		n--;
+		m_buf[m_len++] = (v >> (8*n)) & 0x0ff;
+	}
+	m_wrhdr = 0;
+	binpace(start);
+}
+
+void	HEXENCODER::binread(void) {
+	unsigned	start = m_len;
+
+	reserve(1 + m_pace);
+	m_buf[m_len++] = (char)BINB_READ;
+	m_wrhdr = 0;
+	binpace(start);
+}
+
+/*
+ * HEXENCODER::binwrite
+ *
+ * Writes following one another are placed into the same frame, up to
+ * BINB_MAXWRITE at a time, costing a little over four bytes each.  This can
+ * only be done when not pacing, since padding can't go within a frame.
+ */
+void	HEXENCODER::binwrite(unsigned v) {
+	unsigned	start = m_len;
+
+	reserve(5 + m_pace);
+	if ((m_wrhdr)&&(m_pace == 0)
+			&&((m_buf[m_wrhdr-1] & 0x1f) < BINB_MAXWRITE-1))
+		m_buf[m_wrhdr-1]++;
+	else {
+		m_buf[m_len++] = (char)BINB_WRITE;
+		m_wrhdr = m_len;
+	}
+
+	m_buf[m_len++] = (v >> 24) & 0x0ff;
+	m_buf[m_len++] = (v >> 16) & 0x0ff;
+	m_buf[m_len++] = (v >>  8) & 0x0ff;
+	m_buf[m_len++] =  v        & 0x0ff;
+	if (m_pace) {
+		m_wrhdr = 0;
+		binpace(start);
+	} else
+		m_buf[m_len] = '\0';
+}
+
+/*
+ * binevent
+ *
+ * Maps the letter following an escape to its event.  Read data and addresses
+ * are handled separately, since they carry data.
+ */
+static	HEXDECODER::EVENT	binevent(char cmd) {
+	switch(cmd) {
+	case 'K':	return HEXDECODER::EV_ACK;
+	case 'I':	return HEXDECODER::EV_INT;
+	case 'E':	return HEXDECODER::EV_ERR;
+	case 'T':	return HEXDECODER::EV_RESET;
+	case 'Z':	return HEXDECODER::EV_IDLE;
+	case 'M':	return HEXDECODER::EV_MODE;
+	default:	return HEXDECODER::EV_NONE;
+	}
+}
+
+/*
+ * HEXDECODER::bindecode
+ *
+ * The binary version of decode().  m_cmd holds the letter of the response
+ * whose data we are receiving, if any, and m_nbytes the number of its bytes
+ * still to come.  Read data, once started, continues four bytes at a time
+ * until the next escape.  Anything else arriving outside of a response is
+ * ignored, save for a 'T'.  Any reset returns the FPGA to hexadecimal, and
+ * it then says so in hexadecimal.  Either way, we return to hexadecimal
+ * with it.
+ */
+HEXDECODER::EVENT	HEXDECODER::bindecode(const char *buf, unsigned len,
+		unsigned &used, unsigned &v) {
+	for(unsigned k=0; k<len; k++) {
+		unsigned char	ch = buf[k];
+		EVENT		ev;
+
+		if (m_esc) {
+			m_esc = false;
+			if (ch != BINB_ESC) {
+				m_word = 0;
+				m_cmd  = ch;
+				m_nbytes = ((ch == 'R')||(ch == 'A')
+						||(ch == 'D')||(ch == 'V')) ? 4 : 0;
+				if (m_nbytes)
+					continue;
+				m_cmd = 0;
+				if (EV_NONE == (ev = binevent(ch)))
+					continue;
+				if (ev == EV_RESET)
+					set_binary(false);
+				used = k+1;
+				v = 0;
+				return ev;
+			}
+			// Otherwise, an escaped escape is just data
+		} else if (ch == BINB_ESC) {
+			m_esc = true;
+			continue;
+		}
+
+		if (m_nbytes == 0) {
+			if (ch == 'T') {
+				set_binary(false);
+				used = k+1;
+				v = 0;
+				return EV_RESET;
+			} continue;
+		}
+
+		m_word = (m_word << 8) | ch;
+		if (--m_nbytes == 0) {
+			v = m_word;
+			m_word = 0;
+			if (m_cmd == 'R') {
+				m_nbytes = 4;
+				ev = EV_READ;
+			} else {
+				ev = (m_cmd == 'D') ? EV_REPEAT
+					: (m_cmd == 'V') ? EV_INT : EV_ADDR;
+				m_cmd = 0;
+			}
+			used = k+1;
+			return ev;
+		}
+	}
+
+	used = len;
+	return EV_NONE;
+}
+
+/*
+ * HEXDECODER::binrun
+ *
+ * The binary version of readrun().  Within a run of read responses, every
+ * four bytes are a word--up until the next escape.  We can only start on a
+ * word boundary.
+ */
+unsigned HEXDECODER::binrun(const char *buf, unsigned len, unsigned &used,
+		unsigned *vals, unsigned maxv) {
+	const char	*esc;
+	unsigned	n, nw;
+
+	used = 0;
+	if ((m_esc)||(m_cmd != 'R')||(m_nbytes != 4))
+		return 0;
+
+	if (len > maxv * 4)
+		len = maxv * 4;
+	esc = (const char *)memchr(buf, BINB_ESC, len);
+	if (esc)
+		len = esc - buf;
+
+	nw = len >> 2;
+	for(n=0; n<nw; n++) {
+		const unsigned char *ptr = (const unsigned char *)&buf[4*n];
+
+		vals[n] = (ptr[0] << 24) | (ptr[1] << 16)
+			| (ptr[2] << 8) | ptr[3];
+	}
+
+	used = nw * 4;
+	return nw;
+}
+
+/*
+ * setmode
+ *
+ * Switch the FPGA, and ourselves, to the given HEXB_MODE_* mode: to or from
+ * the binary protocol, and with or without compressed read responses.  The
+ * FPGA decodes everything following the switch command in the new mode, and
+ * acknowledges it with an 'M' in the old mode.  Everything following that is
+ * in the new mode.
+ */
+void	BINBUS::setmode(unsigned mode) {
+	HEXDECODER::EVENT	ev;
+	unsigned		abort_countdown = 3;
+	bool			binary = (mode & HEXB_MODE_BINARY) != 0;
+	BUSW			v;
+
+	// Nothing may be outstanding, lest its response be lost
+	fence();
+
+	m_enc.clear();
+	m_enc.special(HEXB_SPC_MODE, mode);
+	m_dev->write(m_enc.data(), m_enc.size());
+	m_enc.clear();
+	m_enc.set_binary(binary);
+	m_mode = mode;
+
+	do {
+		switch(ev = nextevent(v, true)) {
+		case HEXDECODER::EV_INT:
+			m_interrupt_flag = true;
+			break;
+		case HEXDECODER::EV_RESET:
+			// The FPGA, and so we, are back in hexadecimal
+			m_enc.set_binary(false);
+			m_mode = HEXB_MODE_HEX;
+			m_addr_set = false;
+			return;
+		case HEXDECODER::EV_IDLE:
+			if (0 == --abort_countdown) {
+				m_enc.set_binary(false);
+				m_dec.set_binary(false);
+				m_mode = HEXB_MODE_HEX;
+				throw BUSERR(0);
+			}
+			break;
+		default:
+			break;
+		}
+	} while(ev != HEXDECODER::EV_MODE);
+
+	m_dec.set_binary(binary);
+	DBGPRINTF("MODE: %s%s\n", (binary) ? "BINARY" : "HEX",
+		(mode & HEXB_MODE_RLE) ? ", RLE" : "");
+}
+
+/*
+ * restore
+ *
+ * Return the FPGA to hexadecimal, for the next user.  There's nothing more
+ * we can do if this fails.
+ */
+void	BINBUS::restore(void) {
+	if (m_mode == HEXB_MODE_HEX)
+		return;
+
+	try {
+		setmode(HEXB_MODE_HEX);
+	} catch(...) {
+		m_enc.set_binary(false);
+		m_dec.set_binary(false);
+		m_mode = HEXB_MODE_HEX;
+	}
+}
+
+unsigned	BINBUS::capabilities(void) {
+	bool		known = m_caps_valid;
+	unsigned	caps, mode = HEXB_MODE_HEX;
+
+	caps = HEXBUS::capabilities();
+	if ((known)||(m_mode != HEXB_MODE_HEX)||(!(caps & HEXB_CAP_MODE)))
+		return caps;
+
+	if (caps & HEXB_CAP_BINARY)
+		mode |= HEXB_MODE_BINARY;
+	if (caps & HEXB_CAP_RLE)
+		mode |= HEXB_MODE_RLE;
+	if (mode != HEXB_MODE_HEX)
+		setmode(mode);
+
+	return caps;
+}
+
+//
+// Every bus operation starts by making sure we know what the FPGA supports,
+// and so which protocol to speak
+//
+void	BINBUS::writeio(const BUSW a, const BUSW v) {
+	capabilities();
+	HEXBUS::writeio(a, v);
+}
+
+BINBUS::BUSW	BINBUS::readio(const BUSW a) {
+	capabilities();
+	return HEXBUS::readio(a);
+}
+
+void	BINBUS::readi(const BUSW a, const int len, BUSW *buf) {
+	capabilities();
+	HEXBUS::readi(a, len, buf);
+}
+
+void	BINBUS::readz(const BUSW a, const int len, BUSW *buf) {
+	capabilities();
+	HEXBUS::readz(a, len, buf);
+}
+
+void	BINBUS::writei(const BUSW a, const int len, const BUSW *buf) {
+	capabilities();
+	HEXBUS::writei(a, len, buf);
+}
+
+void	BINBUS::writez(const BUSW a, const int len, const BUSW *buf) {
+	capabilities();
+	HEXBUS::writez(a, len, buf);
+}
@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	binbus.h
+// {{{
+// Project:	dbgbus, a collection of 8b channel to WB bus debugging protocols
+//
+// Purpose:	A version of the HEXBUS that switches the FPGA to the binary
+//		form of the protocol, when the FPGA supports it.  Binary sends
+//	eight bits in every byte, rather than hexbus' four, and so moves a
+//	little more than twice as many words across the same link.  Runs of
+//	identical read responses are also compressed, if the FPGA can.  The
+//	FPGA always starts out speaking hexadecimal, and is returned to it when
+//	we close, so that it may still be used from a terminal.
+//
+//	This code does not run on an FPGA, is not a test bench, neither
+//	is it a simulator.  It is a portion of a command program
+//	for commanding an FPGA.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2017-2024, Gisselquist Technology, LLC
+// {{{
+// This file is part of the hexbus debugging interface.
+//
+// The hexbus interface is free software (firmware): you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// The hexbus interface is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  (It's in the $(ROOT)/doc directory.  Run make
+// with no target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	LGPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/lgpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	BINBUS_H
+#define	BINBUS_H
+
+#include "hexbus.h"
+
+class	BINBUS : public HEXBUS {
+	void	setmode(unsigned mode);
+	void	restore(void);
+public:
+	BINBUS(LLCOMMSI *comms) : HEXBUS(comms) {}
+	virtual	~BINBUS(void) { restore(); }
+
+	// A killed bus can't be switched back, so don't try
+	void	kill(void) { m_enc.set_binary(false); m_dec.set_binary(false);
+			m_mode = HEXB_MODE_HEX; HEXBUS::kill(); }
+	void	close(void) { restore(); HEXBUS::close(); }
+	void	writeio(const BUSW a, const BUSW v);
+	BUSW	readio(const BUSW a);
+	void	readi( const BUSW a, const int len, BUSW *buf);
+	void	readz( const BUSW a, const int len, BUSW *buf);
+	void	writei(const BUSW a, const int len, const BUSW *buf);
+	void	writez(const BUSW a, const int len, const BUSW *buf);
+
+	// As with HEXBUS, but the first time the FPGA is asked, it is also
+	// switched to binary, and to compressed responses, if it can be
+	unsigned capabilities(void);
+
+	// True if we are speaking binary
+	bool	binary(void) const { return m_enc.binary(); }
+};
+
+#endif
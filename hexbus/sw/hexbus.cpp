@@ -60,6 +60,7 @@
 #include <strings.h> 
 #include <poll.h> 
 #include <ctype.h> 
+#include <time.h>
 
 #include "hexbus.h"
 
@@ -70,6 +71,16 @@
 #define	HEXB_RESET	'T'
 #define	HEXB_INT	'I'
 #define	HEXB_ERR	'E'
+#define	HEXB_MODE	'M'
+#define	HEXB_REPEAT	'D'
+#define	HEXB_INTVEC	'V'
+
+// How long to wait, in milliseconds, for a response before checking again
+#define	HEXB_POLLMS	10
+
+// The fewest clocks between idles from the FPGA.  hbidle.v counts 2^23 clocks
+// under Verilator, and far more in hardware.
+#define	HEXB_IDLECLOCKS	(1u<<23)
 
 //
 // Three mutually exclusive possibilities are here for tracing what's going on:
@@ -122,42 +133,302 @@ void	filedump(const char *fmt, ...) {
 	// va_end(args);
 }
 
+// Character classes, as found in hexclass[] below.  Hexadecimal digits are
+// classified by their value, 0-15.
+#define	HC_SPACE	0x10	// White space, ends a response
+#define	HC_CMD		0x20	// Anything else, ends a response and starts a new one
+#define	HC_DROP		0x40	// Idle insert, not a valid code word, skip it
+#define	S	HC_SPACE
+#define	C	HC_CMD
+#define	D	HC_DROP
+static const unsigned char	hexclass[256] = {
+	C, C, C, C, C, C, C, C,  C, S, S, S, S, S, C, C,	// 0x00
+	C, C, C, C, C, C, C, C,  C, C, C, C, C, C, C, C,	// 0x10
+	S, C, C, C, C, C, C, C,  C, C, C, C, C, C, C, C,	// 0x20
+	0, 1, 2, 3, 4, 5, 6, 7,  8, 9, C, C, C, C, C, C,	// 0x30
+	C, C, C, C, C, C, C, C,  C, C, C, C, C, C, C, C,	// 0x40
+	C, C, C, C, C, C, C, C,  C, C, C, C, C, C, C, C,	// 0x50
+	C,10,11,12,13,14,15, C,  C, C, C, C, C, C, C, C,	// 0x60
+	C, C, C, C, C, C, C, C,  C, C, C, C, C, C, C, D,	// 0x70
+	C, C, C, C, C, C, C, C,  C, C, C, C, C, C, C, C,	// 0x80
+	C, C, C, C, C, C, C, C,  C, C, C, C, C, C, C, C,	// 0x90
+	C, C, C, C, C, C, C, C,  C, C, C, C, C, C, C, C,	// 0xa0
+	C, C, C, C, C, C, C, C,  C, C, C, C, C, C, C, C,	// 0xb0
+	C, C, C, C, C, C, C, C,  C, C, C, C, C, C, C, C,	// 0xc0
+	C, C, C, C, C, C, C, C,  C, C, C, C, C, C, C, C,	// 0xd0
+	C, C, C, C, C, C, C, C,  C, C, C, C, C, C, C, C,	// 0xe0
+	C, C, C, C, C, C, C, C,  C, C, C, C, C, C, C, D 	// 0xf0
+};
+#undef	S
+#undef	C
+#undef	D
+
 /*
- * lclreadcode
+ * hexevent
  *
- * Read from our interface, and drop any idle characters (bottom seven bits
- * set) from any interaction.
+ * Maps the character starting a response to the event it produces once the
+ * response is complete.  Anything not listed here is ignored.
  */
-int	HEXBUS::lclreadcode(char *buf, int len) {
-	char	*sp, *dp;
-	int	nr, ret;
+static	HEXDECODER::EVENT	hexevent(char cmd) {
+	switch(cmd) {
+	case HEXB_ADDR:		return HEXDECODER::EV_ADDR;
+	case HEXB_READ:		return HEXDECODER::EV_READ;
+	case HEXB_ACK:		return HEXDECODER::EV_ACK;
+	case HEXB_INT:		return HEXDECODER::EV_INT;
+	case HEXB_ERR:		return HEXDECODER::EV_ERR;
+	case HEXB_RESET:	return HEXDECODER::EV_RESET;
+	case HEXB_IDLE:		return HEXDECODER::EV_IDLE;
+	case HEXB_MODE:		return HEXDECODER::EV_MODE;
+	case HEXB_REPEAT:	return HEXDECODER::EV_REPEAT;
+	case HEXB_INTVEC:	return HEXDECODER::EV_INT;
+	default:		return HEXDECODER::EV_NONE;
+	}
+}
 
-	nr = m_dev->read(buf, len);
-	m_total_nread += nr;
-	ret = nr; sp = buf; dp = buf;
-	for(int i=0; i<nr; i++) {
-		if ((buf[i]&0x7f)==0x7f) {
-			// Idle insert, not a valid code word, skip it
-			sp++;
-		} else {
-			*sp++ = *dp++;
+/*
+ * HEXDECODER::decode
+ *
+ * Every response starts with a command character, and is followed by any
+ * number of hexadecimal digits.  It ends with the next character that isn't
+ * a hexadecimal digit--either white space, or the command character of the
+ * next response.  Once the response has ended and been reported, anything
+ * more until the next command character is ignored.
+ */
+HEXDECODER::EVENT	HEXDECODER::decode(const char *buf, unsigned len,
+		unsigned &used, unsigned &v) {
+	if (m_binary)
+		return bindecode(buf, len, used, v);
+
+	for(unsigned k=0; k<len; k++) {
+		unsigned char	ch = buf[k], cls = hexclass[ch];
+		EVENT		ev;
+
+		if (cls < 16) {
+			m_word = (m_word << 4) | cls;
+			m_empty = false;
+			continue;
+		} else if (cls == HC_DROP)
+			continue;
+
+		ev = (m_isspace) ? EV_NONE : hexevent(m_cmd);
+		v  = m_word;
+
+		m_word = 0;
+		m_empty = true;
+		m_isspace = (cls == HC_SPACE);
+		if (!m_isspace)
+			m_cmd = ch;
+
+		if (ev != EV_NONE) {
+			used = k+1;
+			return ev;
 		}
-	} return ret;
+	}
+
+	used = len;
+	return EV_NONE;
 }
 
 /*
- * bufalloc
+ * rxfill
  *
- * Allocate4 a buffer of at least length (len).  This is similar to realloc().
+ * Waits up to ms milliseconds for something to arrive in the device's
+ * receive ring, if it's empty.  Returns false if nothing arrived.
+ */
+bool	HEXBUS::rxfill(unsigned ms) {
+	unsigned	fill = m_dev->buffered();
+
+	if (!m_dev->rxwait(ms))
+		return false;
+	m_total_nread += m_dev->buffered() - fill;
+
+	return true;
+}
+
+/*
+ * nextevent
+ *
+ * Returns the next event decoded from the device's receive ring, refilling
+ * the ring as necessary.  If block is false and nothing more has arrived,
+ * EV_NONE is returned.
+ */
+HEXDECODER::EVENT	HEXBUS::nextevent(BUSW &v, bool block) {
+	HEXDECODER::EVENT	ev;
+	const char		*buf;
+	unsigned		len, used;
+
+	while(1) {
+		while(m_dev->buffered() > 0) {
+			buf = m_dev->peek(len);
+			ev = m_dec.decode(buf, len, used, v);
+			m_dev->consume(used);
+			if ((ev == HEXDECODER::EV_RESET)&&(m_mode)) {
+				// The FPGA returns to hexadecimal on any
+				// reset, with every other mode turned off,
+				// as has our decoder.  Our encoder must
+				// follow, and the FPGA's capabilities must be
+				// asked for again.
+				m_enc.set_binary(false);
+				m_mode = HEXB_MODE_HEX;
+				m_caps_valid = false;
+			}
+			if (ev == HEXDECODER::EV_RESET)
+				m_repeat = 0;
+			if (ev == HEXDECODER::EV_INT)
+				// A plain interrupt ('I') is line zero, a
+				// vector ('V') lists every line that rose
+				m_intvec |= (v) ? v : 1;
+			if (ev != HEXDECODER::EV_NONE)
+				return ev;
+		}
+
+		if (block) {
+			while(!rxfill(HEXB_POLLMS))
+				;
+		} else if (!rxfill(0))
+			return HEXDECODER::EV_NONE;
+	}
+}
+
+// Every byte value as two lower case hexadecimal digits
+static const char	hexpairs[513] =
+	"000102030405060708090a0b0c0d0e0f"
+	"101112131415161718191a1b1c1d1e1f"
+	"202122232425262728292a2b2c2d2e2f"
+	"303132333435363738393a3b3c3d3e3f"
+	"404142434445464748494a4b4c4d4e4f"
+	"505152535455565758595a5b5c5d5e5f"
+	"606162636465666768696a6b6c6d6e6f"
+	"707172737475767778797a7b7c7d7e7f"
+	"808182838485868788898a8b8c8d8e8f"
+	"909192939495969798999a9b9c9d9e9f"
+	"a0a1a2a3a4a5a6a7a8a9aaabacadaeaf"
+	"b0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+	"c0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+	"d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+	"e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+	"f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+/*
+ * HEXENCODER::grow
  *
+ * Make certain the buffer holds at least len characters.  The buffer at
+ * least doubles whenever it grows, so a batch of commands only ever causes a
+ * handful of allocations the first time through, and none thereafter.
  */
-void	HEXBUS::bufalloc(int len) {
-	if ((m_buf)&&(m_buflen >= len))
+void	HEXENCODER::grow(unsigned len) {
+	unsigned	sz;
+	char		*buf;
+
+	if (len <= m_size)
 		return;
-	if (m_buf)
+	sz = (m_size < 64) ? 64 : m_size;
+	while(sz < len)
+		sz <<= 1;
+
+	buf = new char[sz];
+	if (m_buf) {
+		memcpy(buf, m_buf, m_len+1);
 		delete[] m_buf;
-	m_buflen = (len&(-0x3f))+0x40;
-	m_buf = new char[m_buflen];
+	} else
+		buf[0] = '\0';
+	m_buf  = buf;
+	m_size = sz;
+}
+
+/*
+ * HEXENCODER::hex
+ *
+ * Write v in lower case hex, without any leading zeros, two digits at a time
+ * working backwards from the least significant.  Zero produces no digits at
+ * all, which the FPGA reads as zero.
+ */
+char	*HEXENCODER::hex(char *ptr, unsigned v) {
+	unsigned	n;
+	char		*end;
+
+	n = hexlen(v);
+	end = ptr + n;
+	ptr = end;
+	for(; n >= 2; n -= 2) {
+		ptr -= 2;
+		ptr[0] = hexpairs[2*(v & 0x0ff)];
+		ptr[1] = hexpairs[2*(v & 0x0ff)+1];
+		v >>= 8;
+	} if (n)
+		*--ptr = hexpairs[2*(v & 0x0f)+1];
+
+	return end;
+}
+
+/*
+ * HEXENCODER::pace
+ *
+ * Pad the command starting at start with newlines until it is at least
+ * m_pace characters long.  Newlines are ignored by the hexbus decoder, but
+ * they keep us from sending requests faster than their responses can be
+ * returned.  The command is always terminated with at least one newline.
+ */
+void	HEXENCODER::pace(unsigned start) {
+	do {
+		m_buf[m_len++] = '\n';
+	} while(m_len - start < m_pace);
+	m_buf[m_len] = '\0';
+}
+
+void	HEXENCODER::address(unsigned a) {
+	unsigned	start = m_len;
+
+	if (m_binary) {
+		frame(0xc0, a);
+		return;
+	}
+
+	reserve(10 + m_pace);
+	m_buf[m_len++] = HEXB_ADDR;
+	m_len = hex(&m_buf[m_len], a) - m_buf;
+	pace(start);
+}
+
+void	HEXENCODER::read(void) {
+	unsigned	start = m_len;
+
+	if (m_binary) {
+		binread();
+		return;
+	}
+
+	reserve(2 + m_pace);
+	m_buf[m_len++] = HEXB_READ;
+	pace(start);
+}
+
+void	HEXENCODER::write(unsigned v) {
+	unsigned	start = m_len;
+
+	if (m_binary) {
+		binwrite(v);
+		return;
+	}
+
+	reserve(10 + m_pace);
+	m_buf[m_len++] = 'W';
+	m_len = hex(&m_buf[m_len], v) - m_buf;
+	pace(start);
+}
+
+void	HEXENCODER::special(unsigned cmd, unsigned arg) {
+	unsigned	start = m_len;
+
+	if (m_binary) {
+		frame(0xe0, (arg << 4) | (cmd & 0x0f));
+		return;
+	}
+
+	reserve(10 + m_pace);
+	m_buf[m_len++] = 'S';
+	m_len = hex(&m_buf[m_len], (arg << 4) | (cmd & 0x0f)) - m_buf;
+	pace(start);
 }
 
 /*
@@ -179,59 +450,344 @@ void	HEXBUS::writeio(const BUSW a, const BUSW v) {
  * This internal write function.  This writes a buffer of information to our
  * interface, and the place to study how a write works.
  *
+ * Writes are streamed.  Each command word sent costs one credit, so a write
+ * costs one more for any byte enables or address sent ahead of it, and credits
+ * are only returned as write acknowledgements come back from the FPGA.  As many
+ * requests as we have credits for are assembled into one buffer and sent with
+ * a single write.  Only once we run out of credits do we stop to collect
+ * acknowledgements, and then only as many as we need to continue.  All
+ * outstanding acknowledgements are collected before we return.
+ *
  * Parameters:
  *	a	is the address to write to
  *	p	=1 to increment address, 0 otherwise
  *	len	The number of values to write to the bus
  *	buf	A memory pointer to the information to write
+ *	sel	The bytes of each word to write.  Anything other than all four
+ *		requires an FPGA supporting byte enables (HEXB_CAP_SEL), and
+ *		costs a byte enable command ahead of every write.
  *
- * Notice that this routine can only write complete 32-bit words.  It doesn't
- * really have any 8-bit byte support, although you might be able to create such
- * by readio()'ing a word, modifying it, and then calling writeio() to write the
- * modified word back.
+ * With posted writes, we return once the last write has been sent, leaving
+ * its acknowledgement (and those of any others still outstanding) for the
+ * next fence().
  */
 void	HEXBUS::writev(const BUSW a, const int p, const int len,
-		const BUSW *buf) {
-	char	*ptr;
-	unsigned	nw = 0;
+		const BUSW *buf, const unsigned sel) {
+	unsigned	nw = 0, naddr, cost;
 
 	DBGPRINTF("WRITEV(%08x,%d,#%d,0x%08x ...)\n", a, p, len, buf[0]);
 
+	// Find out how many writes we may stream at once
+	if (len > 1)
+		capabilities();
+
 	// Encode the address
-	ptr = encode_address(a|((p)?0:1));
-	m_lastaddr = a; m_addr_set = true;
-	m_nacks = 0;
-
-	while(nw < (unsigned)len) {
-		*ptr++ = 'W'; *ptr = '\0';
-		if (buf[nw] != 0) {
-			sprintf(ptr, "%x\n", buf[nw]);
-			ptr += strlen(ptr);
-		} else {
-			*ptr++ = '\n';
-			*ptr = '\0';
-		}
+	m_enc.clear();
+	encode_address(a|((p)?0:1));
+	naddr = (m_enc.size() > 0) ? 1:0;
+	if (m_nwrites == m_nacks)
+		m_lastaddr = a;
+	m_addr_set = true;
 
-		DBGPRINTF("WRITEV-SUB(%08x%s,&buf[%d] = 0x%08x,ACKS=%d)\n", a+(nw<<2), (p)?"++":"", nw, buf[nw], m_nacks);
-		m_dev->write(m_buf, ptr-m_buf);
-		DBGPRINTF(">> %s", m_buf);
+	try {
+		while(nw < (unsigned)len) {
+			// Spend whatever credits we have, charging the address
+			// to the first write.  A write is always allowed if
+			// nothing else is outstanding.
+			cost = naddr + (((sel & 0x0f) != 0x0f) ? 2:1);
+			while((nw < (unsigned)len)&&((m_nwrites == m_nacks)
+					||(m_wrslots + cost <= m_wrwindow))) {
+				if ((sel & 0x0f) != 0x0f)
+					m_enc.special(HEXB_SPC_SEL, sel & 0x0f);
+				m_enc.write(buf[nw]);
+				if (m_txinc)
+					m_txaddr += 4;
+
+				DBGPRINTF("WRITEV-SUB(%08x%s,&buf[%d] = 0x%08x,ACKS=%d)\n", a+(nw<<2), (p)?"++":"", nw, buf[nw], m_nacks);
+				wrsent(a + ((p) ? (nw<<2) : 0), cost);
+				nw++;
+				cost -= naddr; naddr = 0;
+			}
 
-		while(m_nacks < (unsigned)nw)
-			readidle();
+			// Send them all at once
+			if (m_enc.size() > 0) {
+				m_dev->write(m_enc.data(), m_enc.size());
+				DBGPRINTF(">> %s", m_enc.data());
+				m_enc.clear();
+			}
 
-		nw ++;
-		ptr = m_buf;
-	}
+			// If we are out of credits, wait for enough to return
+			if (nw < (unsigned)len)
+				drain((m_wrwindow > cost) ? m_wrwindow-cost : 0);
+		}
 
-	DBGPRINTF("Missing %d acks still\n", (unsigned)len-m_nacks);
-	while(m_nacks < (unsigned)len)
-		readidle();
+		DBGPRINTF("Missing %d acks still\n", m_nwrites-m_nacks);
+		if (m_posted)
+			return;
+		fence();
+	} catch(BUSERR b) {
+		// Blame the first write to fail, which may have been posted
+		// by some earlier call
+		BUSW	erraddr = (m_posted_err) ? m_posted_erraddr : b.addr;
+
+		DBGPRINTF("WRITEV::BUSERR writing %08x\n", erraddr);
+
+		// Every write we've sent will still be answered.  Collect
+		// those answers now, rather than confusing them with the
+		// answers to some later request.
+		while(m_nwrites != m_nacks) {
+			try {
+				fence();
+			} catch(BUSERR e) {}
+		}
+		m_posted_err = false;
+
+		// We no longer know where the bus address is at
+		m_addr_set = false;
+		throw BUSERR(erraddr);
+	}
 
 	if (p)
-		m_lastaddr += (len<<2);
+		m_lastaddr = a + (len<<2);
 	DBGPRINTF("WR: LAST ADDRESS LEFT AT %08x\n", m_lastaddr);
 }
 
+/*
+ * drain
+ *
+ * Read and process responses until the writes that remain unacknowledged
+ * cost no more than the given number of command words.
+ */
+void	HEXBUS::drain(unsigned slots) {
+	while((m_nwrites != m_nacks)&&(m_wrslots > slots)) {
+		readidle();
+		if ((m_nwrites != m_nacks)&&(m_wrslots > slots))
+			m_dev->poll(HEXB_POLLMS);
+	}
+}
+
+/*
+ * fence
+ *
+ * Wait until every write we have issued has been acknowledged.  Should one
+ * of them have failed, we still collect every other acknowledgement before
+ * reporting the first failure, so that none of them can be mistaken for the
+ * answer to some later request.  That first failure may have arrived before
+ * the fence, such as while sleeping, and been kept for us until now.
+ */
+void	HEXBUS::fence(void) {
+	BUSW	erraddr;
+
+	while(m_nwrites != m_nacks) {
+		try {
+			drain(0);
+		} catch(BUSERR b) {
+			// readidle() has kept it for us, below
+		}
+	}
+
+	if (m_posted_err) {
+		erraddr = m_posted_erraddr;
+		m_posted_err = false;
+		throw BUSERR(erraddr);
+	}
+}
+
+/*
+ * writes
+ *
+ * Write only the selected bytes of a word.  If the FPGA supports byte enables,
+ * this takes a single write--no read is required.  Otherwise, we fall back to
+ * reading the word, modifying it, and writing it back.
+ */
+void	HEXBUS::writes(const BUSW a, const unsigned sel, const BUSW v) {
+	if ((sel & 0x0f) == 0x0f) {
+		writeio(a, v);
+		return;
+	} else if (!(capabilities() & HEXB_CAP_SEL)) {
+		DEVBUS::writes(a, sel, v);
+		return;
+	}
+
+	writev(a & -4, 0, 1, &v, sel);
+	m_lastaddr = a & -4; m_addr_set = true;
+}
+
+/*
+ * readuntil
+ *
+ * Poll an address until its value, masked, matches what we expect.  If the
+ * FPGA supports it, the polling is done there: we send one poll command,
+ * followed by the mask and expected value as its two arguments, and get back
+ * only the last value read.  Otherwise, DEVBUS::readuntil() polls with
+ * readio() from here.
+ *
+ * The FPGA sends nothing but idles while it polls.  We'll wait through as
+ * many of those as the timeout might take, and only then decide the FPGA
+ * has hung.
+ */
+HEXBUS::BUSW	HEXBUS::readuntil(const BUSW a, const BUSW mask,
+		const BUSW expect, const unsigned timeout, const unsigned clkhz) {
+	BUSW	v;
+
+	if (!(capabilities() & HEXB_CAP_POLL))
+		return DEVBUS::readuntil(a, mask, expect, timeout, clkhz);
+
+	DBGPRINTF("READUNTIL(0x%08x,0x%08x,0x%08x,%d)\n", a, mask, expect,
+		timeout);
+	fence();
+
+	m_enc.clear();
+	encode_address(a | 1);
+	m_enc.special(HEXB_SPC_POLL,
+		(timeout > HEXB_MAXPOLL) ? HEXB_MAXPOLL : timeout);
+	m_enc.write(mask);
+	m_enc.write(expect);
+	m_lastaddr = a; m_addr_set = true; m_inc = false;
+
+	m_dev->write(m_enc.data(), m_enc.size());
+	DBGPRINTF(">> %s", m_enc.data());
+	m_enc.clear();
+
+	try {
+		unsigned	t = (timeout > HEXB_MAXPOLL) ? HEXB_MAXPOLL : timeout;
+
+		v = readword(t / HEXB_IDLECLOCKS + 1 + HEXB_MAXIDLES);
+	} catch(BUSERR b) {
+		DBGPRINTF("READUNTIL::BUSERR trying to read %08x\n", a);
+		throw BUSERR(a);
+	}
+
+	return v;
+}
+
+/*
+ * crc32
+ *
+ * Find the CRC32 of a region of memory.  If the FPGA supports it, the FPGA
+ * reads the region and returns only its CRC, so that we never need to see the
+ * data itself.  Otherwise, DEVBUS::crc32() reads it all back.
+ *
+ * Should the FPGA hit a bus error, we only know that it was somewhere within
+ * the region, and so report it against the first address.
+ */
+HEXBUS::BUSW	HEXBUS::crc32(const BUSW a, const int len) {
+	BUSW	v;
+
+	if (len <= 0)
+		return 0;
+	else if ((len > HEXB_MAXBURST)||(!(capabilities() & HEXB_CAP_CRC)))
+		return DEVBUS::crc32(a, len);
+
+	DBGPRINTF("CRC32(0x%08x,#%d)\n", a, len);
+	fence();
+
+	m_enc.clear();
+	encode_address(a);
+	m_enc.special(HEXB_SPC_CRC, len);
+	if (m_txinc)
+		m_txaddr += len << 2;
+	m_addr_set = true; m_inc = false;
+
+	m_dev->write(m_enc.data(), m_enc.size());
+	DBGPRINTF(">> %s", m_enc.data());
+	m_enc.clear();
+
+	try {
+		v = readword();
+	} catch(BUSERR b) {
+		DBGPRINTF("CRC32::BUSERR within %08x, #%d\n", a, len);
+		m_addr_set = false;
+		throw BUSERR(a);
+	}
+
+	m_lastaddr = a + (len << 2); m_inc = true;
+	return v;
+}
+
+/*
+ * fill
+ *
+ * Write the same value to every word of a region of memory.  If the FPGA
+ * supports it, the value is sent once and the FPGA writes it everywhere.
+ * Otherwise, DEVBUS::fill() writes every word from here.
+ */
+void	HEXBUS::fill(const BUSW a, const int len, const BUSW v) {
+	if (len <= 0)
+		return;
+	else if ((len > HEXB_MAXBURST)||(!(capabilities() & HEXB_CAP_FILL))) {
+		DEVBUS::fill(a, len, v);
+		return;
+	}
+
+	DBGPRINTF("FILL(0x%08x,#%d,0x%08x)\n", a, len, v);
+
+	m_enc.clear();
+	encode_address(a);
+	m_enc.special(HEXB_SPC_FILL, len);
+	m_enc.write(v);
+	blockop(a, len);
+}
+
+/*
+ * copy
+ *
+ * Copy one region of memory to another.  If the FPGA supports it, the FPGA
+ * moves the data itself, one word at a time.  Otherwise, DEVBUS::copy() reads
+ * it all back and writes it out again.
+ */
+void	HEXBUS::copy(const BUSW dst, const BUSW src, const int len) {
+	if (len <= 0)
+		return;
+	else if ((len > HEXB_MAXBURST)||(!(capabilities() & HEXB_CAP_COPY))) {
+		DEVBUS::copy(dst, src, len);
+		return;
+	}
+
+	DBGPRINTF("COPY(0x%08x,0x%08x,#%d)\n", dst, src, len);
+
+	m_enc.clear();
+	encode_address(dst);
+	m_enc.special(HEXB_SPC_COPY, len);
+	m_enc.write(src);
+	blockop(dst, len);
+}
+
+/*
+ * blockop
+ *
+ * Send a fill or copy of len words to address a, already encoded, and wait
+ * for its one acknowledgement.  As with crc32(), a bus error could have been
+ * anywhere within the region, so we report it against the first address.
+ */
+void	HEXBUS::blockop(const BUSW a, const int len) {
+	BUSW	v;
+
+	if (m_txinc)
+		m_txaddr += len << 2;
+	m_addr_set = true; m_inc = false;
+
+	m_dev->write(m_enc.data(), m_enc.size());
+	DBGPRINTF(">> %s", m_enc.data());
+	m_enc.clear();
+
+	wrsent(a);
+	try {
+		while(HEXB_ACK != readresponse(v))
+			;
+	} catch(BUSERR b) {
+		DBGPRINTF("BLOCKOP::BUSERR within %08x, #%d\n", a, len);
+		// The error completes the block, just as its
+		// acknowledgement would
+		if (m_nacks != m_nwrites)
+			ackwrite();
+		m_addr_set = false;
+		throw BUSERR(a);
+	}
+
+	m_lastaddr = a + (len << 2); m_inc = true;
+}
+
 /*
  * writez
  *
@@ -294,46 +850,111 @@ HEXBUS::BUSW	HEXBUS::readio(const HEXBUS::BUSW a) {
  * in it.  If the low order bit of the address is set, then the address
  * will not increment as operations are applied.
  *
- * For the hexbus interface, this is just about as simple as a sprintf(),
- * although other interfaces are more complicated.
+ * If we know where the bus address is, the new address may instead be sent
+ * as a difference from it, by setting the second bit.  Leading zeros are
+ * never sent, so we use whichever of the two takes the fewest digits (or, in
+ * binary, the fewest bytes).  Since
+ * the FPGA fills any missing upper bits with zeros, only a forward difference
+ * can ever be shorter--a step backwards takes all eight digits.
  */
-char	*HEXBUS::encode_address(const HEXBUS::BUSW a) {
-	char	*ptr = m_buf;
+void	HEXBUS::encode_address(const HEXBUS::BUSW a) {
+	unsigned	absaddr, diff;
 
-
-	if ((m_addr_set)&&(a == m_lastaddr)&&(m_inc == ((a&1)^1))) {
+	// Requests may be in flight, so we compare against where the address
+	// will be once they complete, m_txaddr, rather than the last address
+	// the bus told us about.
+	if ((m_addr_set)&&((a&-4) == m_txaddr)&&(m_txinc == ((a&1)^1))) {
 		DBGPRINTF("Address is already set to %08x\n", a);
-		return ptr;
+		return;
 	}
 
-	// An address starts with an address command word indicator
-	*ptr++ = HEXB_ADDR;
+	absaddr = (a & -4) | (a & 1);
+	diff    = ((a - m_txaddr) & -4) | 2 | (a & 1);
+	if ((m_addr_set)&&(m_enc.cost(diff) < m_enc.cost(absaddr))) {
+		DBGPRINTF("ADDR-CMD: %08x + %08x\n", m_txaddr, diff & -4);
+		m_enc.address(diff);
+	} else {
+		DBGPRINTF("ADDR-CMD: %08x\n", absaddr);
+		m_enc.address(absaddr);
+	}
 
-	// Followed by the address in lower-case hex
-	// While I hate providing *ALL EIGHT* hex digits to this function,
-	// failing to do so causes overflows within the hexbus right now.
-	sprintf(ptr, "%08x", a);
+	m_txaddr = a & -4;
+	m_txinc  = (a&1)^1;
+}
 
 /*
-	// If we can use an address difference, will it be valuable to do so?
-	// Not quite yet in our current design.
-	if (m_addr_set) {
-		char	diff[9];
+ * capabilities
+ *
+ * Ask the FPGA what it supports.  The capability query is followed by an
+ * address difference of zero, which leaves the bus address where it was.  An
+ * FPGA that understands the query answers it with a data word before it
+ * echoes that address back.  One that doesn't answers with the address alone,
+ * and so reports no capabilities at all.
+ *
+ * If the FPGA has a command FIFO, then it holds each command until it can be
+ * answered.  Commands no longer need to be paced, and as many may be in flight
+ * as the FIFO will hold.  A FIFO must hold at least four commands, the most
+ * we ever send without waiting on a response (a poll), for this to help.
+ */
+unsigned	HEXBUS::capabilities(void) {
+	HEXDECODER::EVENT	ev;
+	unsigned		abort_countdown = HEXB_MAXIDLES;
+	BUSW			v;
 
-		sprintf(diff, "%x", a-m_lastaddr);
+	if (m_caps_valid)
+		return m_caps;
 
-		if (strlen(diff) < strlen(ptr))
-			strcpy(ptr, diff);
-	}
-*/
-	ptr += strlen(ptr);
-	*ptr = '\0';
+	// Nothing may be outstanding, lest its response be confused with ours
+	fence();
 
-	DBGPRINTF("ADDR-CMD: \'%s\' (a was %08x)\n", m_buf, a);
+	m_enc.clear();
+	m_enc.special(HEXB_SPC_CAPS, 0);
+	m_enc.address(2 | ((m_txinc) ? 0:1));
+	m_dev->write(m_enc.data(), m_enc.size());
+	DBGPRINTF(">> %s", m_enc.data());
+	m_enc.clear();
 
-	return ptr;
-}
+	m_caps = 0;
+	do {
+		switch(ev = nextevent(v, true)) {
+		case HEXDECODER::EV_READ:
+			m_caps = m_lastread = v;
+			break;
+		case HEXDECODER::EV_REPEAT:
+			// Our answer was the same as the last word read
+			m_caps = m_lastread;
+			break;
+		case HEXDECODER::EV_INT:
+			m_interrupt_flag = true;
+			break;
+		case HEXDECODER::EV_IDLE:
+			if (0 == --abort_countdown)
+				throw BUSERR(0);
+			break;
+		default:
+			break;
+		}
+	} while(ev != HEXDECODER::EV_ADDR);
+
+	// Whether or not we knew it before, we now know where the bus
+	// address is
+	m_addr_set  = true;
+	m_inc       = (v & 1) ? 0:1;
+	m_lastaddr  = v & -4;
+	m_txaddr    = m_lastaddr;
+	m_txinc     = m_inc;
+
+	DBGPRINTF("CAPABILITIES: %08x\n", m_caps);
+	m_caps_valid = true;
+
+	if (HEXB_CAP_LGFIFO(m_caps) >= 2) {
+		m_fifolen = 1u << HEXB_CAP_LGFIFO(m_caps);
+		m_enc.set_pace(0);
+		m_rdwindow = m_wrwindow = m_fifolen;
+	}
 
+	return m_caps;
+}
 
 /*
  * readv
@@ -342,6 +963,15 @@ char	*HEXBUS::encode_address(const HEXBUS::BUSW a) {
  * end up here.  readv() reads a buffer of data from the given address, and
  * optionally increments (or not) the address after every read.
  *
+ * Rather than waiting on the response to each read request before issuing
+ * the next, readv() keeps up to m_rdwindow requests in flight.  Responses
+ * come back in the order the requests were made, so each response is simply
+ * matched to the oldest outstanding request.
+ *
+ * If the FPGA supports burst reads, then multiword reads are instead made
+ * with a single burst request.  The FPGA then returns words as fast as the
+ * link allows, with no further requests needed.
+ *
  * Parameters:
  *	a	The address to start reading from
  *	inc	'1' if we want to increment the address following each read,
@@ -351,36 +981,82 @@ char	*HEXBUS::encode_address(const HEXBUS::BUSW a) {
  * 
  */
 void	HEXBUS::readv(const HEXBUS::BUSW a, const int inc, const int len, HEXBUS::BUSW *buf) {
-	int	nread = 0;
-	char	*ptr = m_buf;
+	int	nread = 0, nsent = 0, naddr;
+	bool	burst;
 
 	if (len <= 0)
 		return;
 	DBGPRINTF("READV(%08x,%d,#%4d)\n", a, inc, len);
 
-	ptr = encode_address(a | ((inc)?0:1));
+	// Any posted writes must be answered first, lest their answers (or
+	// errors) be taken for ours
+	fence();
+
+	burst = (len > 1)&&(capabilities() & HEXB_CAP_BURST);
+
+	m_enc.clear();
+	encode_address(a | ((inc)?0:1));
+	// The address takes a slot in the FPGA's command FIFO as well, until
+	// the first word comes back
+	naddr = (m_enc.size() > 0) ? 1:0;
 	m_lastaddr = a; m_addr_set = true; m_inc = inc;
 	try {
 	    while(nread < len) {
-		*ptr++ = HEXB_READ; // This will be a read request
+		if (burst) {
+			// The FPGA ignores any other requests until a burst
+			// completes, so only start a new one once the last
+			// is done.
+			if (nsent == nread) {
+				int	n = len - nsent;
+
+				if (n > HEXB_MAXBURST)
+					n = HEXB_MAXBURST;
+				m_enc.special(HEXB_SPC_BURST, n);
+				if (m_txinc)
+					m_txaddr += n << 2;
+				nsent += n;
+			}
+		} else while((nsent < len)&&((nsent == nread)
+				||(nsent - nread + naddr < (int)m_rdwindow))) {
+			// Top up the window of outstanding read requests
+			//
+			// No other characters needed.  However, the encoder
+			// will pad the request so as not to overrun the
+			// return channel.
+			m_enc.read();
+			if (m_txinc)
+				m_txaddr += 4;
+			nsent++;
+		}
 
-		// No other characters needed.  However, without a FIFO
-		// we'll need to terminate this command and wait for a
-		// response.
-		*ptr++ = '\n';
-		*ptr = '\0';
+		// Send everything we've queued in one write
+		if (m_enc.size() > 0) {
+			m_dev->write(m_enc.data(), m_enc.size());
 
-		m_dev->write(m_buf, (ptr-m_buf));
+			// Clear the command buffer so we can start over
+			m_enc.clear();
+		}
 
-		// Read the result from the bus
-		buf[nread++] = readword();
+		// Read the result(s) from the bus
+		nread += readwords(nsent - nread, &buf[nread]);
+		naddr = 0;
 		DBGPRINTF("READV [%08x/%08x] = %08x\n", nread-1, len, buf[nread-1]);
-
-		// Clear the command buffer so we can start over
-		ptr = m_buf;
 	    }
 	} catch(BUSERR b) {
 		DBGPRINTF("READV::BUSERR trying to read %08x\n", a+((inc)?(nread<<2):0));
+
+		// Any requests still in flight will still produce responses.
+		// Flush them, so they aren't mistaken for the answers to
+		// some later request.  A bus error ends a burst, so there's
+		// nothing to flush following one.
+		for(int k=nread+1; (!burst)&&(k<nsent); k++) {
+			try {
+				readword();
+			} catch(BUSERR e) {}
+		}
+
+		// We no longer know where the bus address is at
+		m_addr_set = false;
 		throw BUSERR(a+((inc)?(nread<<2):0));
 	} catch(...) {
 		DBGPRINTF("Some other error caught\n");
@@ -430,101 +1106,284 @@ void	HEXBUS::readz(const HEXBUS::BUSW a, const int len, HEXBUS::BUSW *buf) {
 }
 
 /*
- * readword()
+ * flush
  *
- * Once the read command has been issued, readword() is called to read each
- * word's response from the bus.  This also processes any out of bounds
- * characters, such as interrupt notifications or bus error condition
- * notifications.
- */
-HEXBUS::BUSW	HEXBUS::readword(void) {
-	int		nr;
-	unsigned	word, result, abort_countdown;
-	bool		done = false;
-	const bool	dbg  = false;
+ * Issue a batch of operations.  The entire batch is encoded into one outgoing
+ * stream, sent a window at a time, and the responses are then parsed in one
+ * pass.  Since responses return in the order their requests were made, each
+ * response belongs to the oldest request not yet answered.  A bus error is
+ * recorded against the operation that caused it, and the rest of the batch
+ * continues.
+ *
+ * If the FPGA supports them, multiword reads are made with a single burst
+ * request.  Since the FPGA ignores anything else sent during a burst, nothing
+ * more is sent until every word of the burst has been received.
+ */
+void	HEXBUS::flush(BUSBATCH &b) {
+	int	tx_op = 0, tx_k = 0, rx_op = 0, rx_k = 0, burst_op = -1;
+	unsigned	window, nsent = 0, nrcvd = 0, inflight;
+	bool	burst = false;
+	BUSW	v;
+	// For every address command sent, the number of requests sent before
+	// it.  Each takes a slot in the FPGA's command FIFO until the request
+	// following it has been answered.
+	std::deque<unsigned>	addrs;
+
+	// Make sure nothing else is outstanding before we start
+	fence();
+
+	burst  = (capabilities() & HEXB_CAP_BURST) != 0;
+	window = (m_rdwindow < m_wrwindow) ? m_rdwindow : m_wrwindow;
+
+	DBGPRINTF("FLUSH(#%d ops)\n", b.size());
+	while(rx_op < b.size()) {
+		// Skip over any operations already complete, or with nothing
+		// to do
+		if ((b[rx_op].m_done)||(b[rx_op].m_len <= 0)) {
+			b[rx_op].m_done = true;
+			rx_op++; rx_k = 0;
+			if (tx_op < rx_op) {
+				tx_op = rx_op; tx_k = 0;
+			}
+			continue;
+		}
 
-	if (dbg) DBGPRINTF("READ-WORD()\n");
+		// Fill the window with as many requests as it will hold
+		m_enc.clear();
+		while((!addrs.empty())&&(addrs.front() < nrcvd))
+			addrs.pop_front();
+		while((tx_op < b.size())&&(burst_op < rx_op)) {
+			BUSBATCH::BUSOP	&op = b[tx_op];
 
-	abort_countdown = 3;
-	word = 0;
-	do {
-		// Blocking read (for now)
-		do {
-			nr = lclreadcode(&m_buf[0], 1);
-		} while (nr < 1);
-		if (dbg) DBGPRINTF("READWORD: -- lclreadcode, nr = %d, m_buf[0] = %c (%02x)\n",
-				nr, isgraph(m_buf[0])?m_buf[0]:'.',
-				m_buf[0] & 0x0ff);
-
-		// If the character is a lower case hexadecimal digit, shift our
-		// word by four bits and set the lower four bits with this
-		// value.
-		if (isdigit(m_buf[0])) {
-			m_isspace = false;
-			word = (word << 4) | (m_buf[0] & 0x0f);
-		} else if ((m_buf[0] >= 'a')&&(m_buf[0] <= 'f')) {
-			m_isspace = false;
-			word = (word << 4) | ((m_buf[0] - 'a' + 10)&0x0f);
-		} else {
-			if (dbg) DBGPRINTF("RCVD OTHER-CHAR(%c), m_cmd = %02x (%c), word=0x%08x\n",
-				isgraph(m_buf[0])?m_buf[0]:'.',
-				m_cmd & 0x0ff, isgraph(m_cmd)?m_cmd:'.', word);
-			if (m_isspace) {
-				// Ignore multiple spaces
-			} else if (m_cmd == HEXB_READ) {
-				if (m_inc)
-					m_lastaddr += 4;
-				if (dbg) DBGPRINTF("RCVD WORD: 0x%08x\n", word);
-				result = word;
-				done = true;
-			} else if (m_cmd == HEXB_ACK) {
-				// Write acknowledgement
-				if (m_inc)
-					m_lastaddr += 4;
-				m_nacks++;
-			} else if (m_cmd == HEXB_INT) {
-				m_interrupt_flag = true;
-			} else if (m_cmd == HEXB_ERR) {
-				if (dbg) DBGPRINTF("Bus error(0x%08x)-readword\n",m_lastaddr);
-				m_bus_err = true;
-				m_isspace = isspace(m_buf[0]);
-				if (!m_isspace)
-					m_cmd = m_buf[0];
-				throw BUSERR(m_lastaddr);
-			} else if (m_cmd == HEXB_IDLE) {
-				abort_countdown--;
-				if (0 == abort_countdown) {
-					if (dbg) DBGPRINTF("Bus error(0x%08x,ABORT)\n",
-						m_lastaddr);
-					throw BUSERR(0);
-				}
-			} else if (m_cmd == HEXB_ADDR) {
-				m_addr_set  = true;
-				m_inc       = (word & 1) ? 0:1;
-				m_lastaddr  = word & -4;
-				if (dbg) DBGPRINTF("RCVD ADDR: 0x%08x%s\n", (word&-4),
-					(m_inc)?" INC":"");
-			} else if (m_cmd == HEXB_RESET) {
+			if ((op.m_done)||(op.m_len <= 0)) {
+				tx_op++; tx_k = 0;
+				continue;
+			}
+
+			// Every command word counts against the window, so
+			// leave room for an address as well as the request
+			inflight = nsent - nrcvd + addrs.size();
+			if ((inflight > 0)
+					&&(inflight + ((tx_k == 0) ? 2:1) > window))
+				break;
+
+			if (tx_k == 0) {
+				unsigned	sz = m_enc.size();
+
+				encode_address(op.m_addr | ((op.m_inc) ? 0:1));
+				if (m_enc.size() != sz)
+					addrs.push_back(nsent);
+				m_addr_set = true;
+			}
+
+			if ((burst)&&(tx_k == 0)&&(!op.m_write)&&(op.m_len > 1)
+					&&(op.m_len <= HEXB_MAXBURST)) {
+				// Read the whole operation with one request
+				m_enc.special(HEXB_SPC_BURST, op.m_len);
+				if (m_txinc)
+					m_txaddr += op.m_len << 2;
+				nsent += op.m_len;
+				burst_op = tx_op;
+				tx_op++;
+				continue;
+			}
+
+			if (op.m_write) {
+				m_enc.write(op.wbuf()[tx_k]);
+				wrsent(op.m_addr + ((op.m_inc) ? (tx_k<<2) : 0));
+			} else
+				m_enc.read();
+			if (m_txinc)
+				m_txaddr += 4;
+			nsent++;
+
+			if (++tx_k >= op.m_len) {
+				tx_op++; tx_k = 0;
+			}
+		}
+
+		if (m_enc.size() > 0)
+			m_dev->write(m_enc.data(), m_enc.size());
+
+		// Now collect the response to the oldest request
+		BUSBATCH::BUSOP	&op = b[rx_op];
+		try {
+			if (HEXB_READ == readresponse(v)) {
+				if (op.m_write) {
+					// Should never happen
+					DBGPRINTF("FLUSH: Read response to a write request\n");
+					m_addr_set = false;
+				} else
+					op.rbuf()[rx_k] = v;
+			} else if (!op.m_write) {
+				// Should never happen
+				DBGPRINTF("FLUSH: Ack response to a read request\n");
 				m_addr_set = false;
-			} else {
-				if (dbg) DBGPRINTF("Other OOB info read, CMD = %c (%02x)\n", isgraph(m_cmd)?m_cmd:'.', m_cmd & 0x0ff);
 			}
+		} catch(BUSERR e) {
+			if (op.m_write)
+				ackwrite();
+			if (!op.m_err) {
+				op.m_err = true;
+				op.m_erraddr = op.m_addr
+					+ ((op.m_inc) ? (rx_k<<2) : 0);
+			}
+			if (rx_op == burst_op) {
+				// The error ended the burst, no more of its
+				// words will be returned
+				nrcvd += op.m_len - rx_k - 1;
+				rx_k = op.m_len - 1;
+			}
+			m_addr_set = false;
+		}
+		nrcvd++;
+
+		if (++rx_k >= op.m_len) {
+			op.m_done = true;
+			rx_op++; rx_k = 0;
+		}
+	}
+
+	if (!m_addr_set)
+		DBGPRINTF("FLUSH: Bus address lost\n");
+	else
+		m_lastaddr = m_txaddr;
+}
 
-			// Any out of band character other than a newline is
-			// a new command that we start here
-			if (!isspace(m_buf[0])) {
-				m_cmd = m_buf[0];
-				if (dbg) DBGPRINTF("SETTING-NEW-CMD VALUE, CMD = %c (%02x)\n",
-					isgraph(m_cmd)?m_cmd:'.', m_cmd & 0x0ff);
-				m_isspace = false;
-			} else m_isspace = true;
-
-			// Clear the register so we can receive the next word
-			word = 0;
+/*
+ * readword()
+ *
+ * Once the read command has been issued, readword() is called to read each
+ * word's response from the bus.  Any write acknowledgements that come first
+ * are counted along the way.  Once maxidles idles in a row have come
+ * with no response, the FPGA is taken to have hung.
+ */
+HEXBUS::BUSW	HEXBUS::readword(const unsigned maxidles) {
+	BUSW	v;
+
+	while(HEXB_READ != readresponse(v, maxidles))
+		;
+	return v;
+}
+
+/*
+ * readwords()
+ *
+ * Reads the responses to up to len outstanding read requests, returning how
+ * many were read.  Repeats of the last word are returned first, and runs of
+ * read responses already waiting in the device's receive ring are then
+ * decoded in bulk, if the decoder has a way of doing so.  Anything else is
+ * handed to readword().
+ */
+int	HEXBUS::readwords(const int len, BUSW *buf) {
+	const char	*rx;
+	unsigned	ln, used, nw;
+
+	if (m_repeat > 0) {
+		nw = ((unsigned)len < m_repeat) ? len : m_repeat;
+		for(unsigned k=0; k<nw; k++)
+			buf[k] = m_lastread;
+		m_repeat -= nw;
+		if (m_inc)
+			m_lastaddr += nw << 2;
+		return nw;
+	}
+
+	if ((m_dev->buffered() > 0)&&(m_dec.hasrun())) {
+		rx = m_dev->peek(ln);
+		nw = m_dec.readrun(rx, ln, used, buf, len);
+		m_dev->consume(used);
+		if (nw > 0) {
+			m_lastread = buf[nw-1];
+			if (m_inc)
+				m_lastaddr += nw << 2;
+			return nw;
 		}
-	} while(!done);
+	}
 
-	return result;
+	buf[0] = readword();
+	return 1;
+}
+
+/*
+ * readresponse()
+ *
+ * Reads the response to exactly one bus request: either a read response,
+ * whose value is placed into v and for which HEXB_READ is returned, or a
+ * write acknowledgement, for which HEXB_ACK is returned.  This also processes
+ * any out of bounds characters, such as interrupt notifications or bus error
+ * condition notifications.  A bus error is thrown as a BUSERR.
+ *
+ * A repeat stands in for that many read responses, each a copy of the last.
+ * These are returned one at a time, before anything else is read.
+ */
+int	HEXBUS::readresponse(BUSW &v, const unsigned maxidles) {
+	unsigned	abort_countdown;
+	const bool	dbg  = false;
+
+	if (dbg) DBGPRINTF("READ-RESPONSE()\n");
+
+	if (m_repeat > 0) {
+		m_repeat--;
+		v = m_lastread;
+		if (m_inc)
+			m_lastaddr += 4;
+		return HEXB_READ;
+	}
+
+	abort_countdown = maxidles;
+	while(1) {
+		switch(nextevent(v, true)) {
+		case HEXDECODER::EV_READ:
+			m_lastread = v;
+			if (m_inc)
+				m_lastaddr += 4;
+			if (dbg) DBGPRINTF("RCVD WORD: 0x%08x\n", v);
+			return HEXB_READ;
+		case HEXDECODER::EV_REPEAT:
+			if (v == 0)
+				break;
+			if (dbg) DBGPRINTF("RCVD REPEAT: %d more\n", v);
+			m_repeat = v - 1;
+			v = m_lastread;
+			if (m_inc)
+				m_lastaddr += 4;
+			return HEXB_READ;
+		case HEXDECODER::EV_ACK:
+			// Write acknowledgement
+			if (m_inc)
+				m_lastaddr += 4;
+			ackwrite();
+			return HEXB_ACK;
+		case HEXDECODER::EV_INT:
+			m_interrupt_flag = true;
+			break;
+		case HEXDECODER::EV_ERR:
+			if (dbg) DBGPRINTF("Bus error(0x%08x)-readword\n",m_lastaddr);
+			m_bus_err = true;
+			throw BUSERR(m_lastaddr);
+		case HEXDECODER::EV_IDLE:
+			abort_countdown--;
+			if (0 == abort_countdown) {
+				if (dbg) DBGPRINTF("Bus error(0x%08x,ABORT)\n",
+					m_lastaddr);
+				throw BUSERR(0);
+			}
+			break;
+		case HEXDECODER::EV_ADDR:
+			m_addr_set  = true;
+			m_inc       = (v & 1) ? 0:1;
+			m_lastaddr  = v & -4;
+			if (dbg) DBGPRINTF("RCVD ADDR: 0x%08x%s\n", (v&-4),
+				(m_inc)?" INC":"");
+			break;
+		case HEXDECODER::EV_RESET:
+			m_addr_set = false;
+			break;
+		default:
+			break;
+		}
+	}
 }
 
 /*
@@ -535,79 +1394,78 @@ HEXBUS::BUSW	HEXBUS::readword(void) {
  * case anything else is in the stream ... we mostly ignore that here too.
  */
 void	HEXBUS::readidle(void) {
-	unsigned	word;
+	HEXDECODER::EVENT	ev;
+	BUSW			v;
 
 	if (!gbl_last_readidle) {
 		DBGPRINTF("READ-IDLE()\n");
 		gbl_last_readidle = true;
 	}
 
-	// Start by clearing the register
-	word = 0;
-
 	// Repeat as long as there are values to be read
-	while(m_dev->available()) {
-		// Read one character from the interface
-		lclreadcode(&m_buf[0], 1);	// Number read must be one
-
-		// If it's a hexadecimal digit, adjust our word register
-		if (isdigit(m_buf[0]))
-			word = (word << 4) | (m_buf[0] & 0x0f);
-		else if ((m_buf[0] >= 'a')&&(m_buf[0] <= 'f'))
-			word = (word << 4) | ((m_buf[0] - 'a' + 10)&0x0f);
-		else if ((isspace(m_buf[0]))&&(m_isspace)) {
-			// Ignore multiple spaces in a row
-		} else {
-			// Any thing else identifies the beginning (or end)
-			// of a response word.  Deal with it based upon the
-			// last response m_cmd received.
-			if (m_isspace) {
-				// Ignore the previous command if we've
-				// already had a space between use
-			} else if (m_cmd == HEXB_ADDR) {
-				// Received an address word
-				m_addr_set  = true;
-				m_inc       = (word & 1) ? 0:1;
-				m_lastaddr  = word & -4;
-				DBGPRINTF("RCVD ADDR: 0x%08x%s\n", word&-3,
-					(m_inc)?" INC":"");
-			} else if (m_cmd == HEXB_READ) {
-				// Read data ... doesn't make sense in this
-				// context, so we'll just ignore it
-				if (m_inc)
-					m_lastaddr += 4;
-			} else if (m_cmd == HEXB_INT) {
-				// On an interrupt, just set the flag to note
-				// we've received one.
-				m_interrupt_flag = true;
-			} else if (m_cmd == HEXB_ACK) {
-				// Write acknowledgement.  writev() will check
-				// whether the correct number of
-				// acknoweledgments has been received before
-				// moving on.  Read and note it here.
-				if (m_inc)
-					m_lastaddr += 4;
-				m_nacks++;
-			} else if (m_cmd == HEXB_ERR) {
-				// On an err, throw a BUSERR exception
-				DBGPRINTF("Bus error(%08x)-readidle\n", m_lastaddr);
-				m_bus_err = true;
-				throw BUSERR(m_lastaddr);
-			} else if (m_cmd == HEXB_RESET) {
-				DBGPRINTF("BUS RESET\n");
-				// On any reset, clear the address set flag
-				// and any unacknowledged bus error condition
-				m_addr_set = false;
-				m_bus_err = false;
+	while(HEXDECODER::EV_NONE != (ev = nextevent(v, false))) {
+		switch(ev) {
+		case HEXDECODER::EV_ADDR:
+			// Received an address word
+			m_addr_set  = true;
+			m_inc       = (v & 1) ? 0:1;
+			m_lastaddr  = v & -4;
+			DBGPRINTF("RCVD ADDR: 0x%08x%s\n", v&-3,
+				(m_inc)?" INC":"");
+			break;
+		case HEXDECODER::EV_READ:
+			// Read data ... doesn't make sense in this
+			// context, so we'll just ignore it
+			m_lastread = v;
+			if (m_inc)
+				m_lastaddr += 4;
+			break;
+		case HEXDECODER::EV_REPEAT:
+			// As would any repeats of it
+			if (m_inc)
+				m_lastaddr += v << 2;
+			break;
+		case HEXDECODER::EV_INT:
+			// On an interrupt, just set the flag to note
+			// we've received one.
+			m_interrupt_flag = true;
+			break;
+		case HEXDECODER::EV_ACK:
+			// Write acknowledgement.  writev() will check
+			// whether the correct number of
+			// acknoweledgments has been received before
+			// moving on.  Read and note it here.
+			if (m_inc)
+				m_lastaddr += 4;
+			ackwrite();
+			break;
+		case HEXDECODER::EV_ERR:
+			// On an err, throw a BUSERR exception
+			DBGPRINTF("Bus error(%08x)-readidle\n", m_lastaddr);
+			m_bus_err = true;
+			if (m_inc)
+				m_lastaddr += 4;
+			// The error completes the oldest write request
+			// just as any acknowledgement would, and is
+			// blamed on that write's address
+			if (m_nacks != m_nwrites) {
+				BUSW	a = ackwrite();
+
+				// Keep it for fence(), should our caller
+				// be unable to report it
+				wrfailed(a);
+				throw BUSERR(a);
 			}
-
-			// Any out of band character other than a whitespace
-			// is a new command starting--keep track of which
-			// command it is.
-			if (!isspace(m_buf[0]))
-				m_cmd = m_buf[0];
-			m_isspace = (isspace(m_buf[0]))?true:false;
-			word = 0;
+			throw BUSERR(m_lastaddr-((m_inc)?4:0));
+		case HEXDECODER::EV_RESET:
+			DBGPRINTF("BUS RESET\n");
+			// On any reset, clear the address set flag
+			// and any unacknowledged bus error condition
+			m_addr_set = false;
+			m_bus_err = false;
+			break;
+		default:
+			break;
 		}
 	}
 }
@@ -619,48 +1477,104 @@ void	HEXBUS::readidle(void) {
  * bus.
  */
 void	HEXBUS::usleep(unsigned ms) {
-	if (m_dev->poll(ms)) {
-		int	nr;
-		nr = m_dev->read(m_buf, 16);
-		m_total_nread += nr;
-		if (nr == 0) {
-			// Connection closed, let it drop
-			DBGPRINTF("Connection closed!!\n");
-			m_dev->close();
-			exit(-1);
-		} for(int i=0; i<nr; i++) {
-			if (m_buf[i] == HEXB_INT) {
-				m_interrupt_flag = true;
-				DBGPRINTF("!!!!!!!!!!!!!!!!! ----- INTERRUPT!\n");
-			} else if (m_buf[i] == HEXB_IDLE) {
-				DBGPRINTF("Interface is now idle\n");
-			} else if (m_buf[i] == HEXB_ACK) {
-			} else if (m_buf[i] == HEXB_RESET) {
-				DBGPRINTF("Bus was RESET!\n");
-				m_bus_err = false;
-			} else if (m_buf[i] == HEXB_ERR) {
+	struct	timespec	now, deadline;
+	unsigned		left = ms;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec  += ms / 1000;
+	deadline.tv_nsec += (ms % 1000) * 1000000l;
+	if (deadline.tv_nsec >= 1000000000l) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000l;
+	}
+
+	// Anything else arriving in the meantime, such as the answers to
+	// posted writes or idles, is processed as it arrives, and we then go
+	// back to waiting for the rest of our time
+	do {
+		if (rxfill(left)) {
+			try {
+				readidle();
+			} catch(BUSERR b) {
+				// readidle() has already set m_bus_err for us,
+				// and kept any write's failure for the next
+				// fence()
 				DBGPRINTF("Bus error\n");
-				m_bus_err = true;
 			}
-			// else if (m_buf[nr] == 'Q')
-			// else if (m_buf[nr] == 'W')
-			// else if (m_buf[nr] == '\n')
 		}
-	}
+
+		if (m_interrupt_flag) {
+			DBGPRINTF("!!!!!!!!!!!!!!!!! ----- INTERRUPT!\n");
+			break;
+		} else if (ms == LLCOMMS_FOREVER)
+			continue;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if ((now.tv_sec > deadline.tv_sec)
+				||((now.tv_sec == deadline.tv_sec)
+				&&(now.tv_nsec >= deadline.tv_nsec)))
+			left = 0;
+		else
+			left = (deadline.tv_sec - now.tv_sec) * 1000
+				+ (deadline.tv_nsec - now.tv_nsec + 999999)
+					/ 1000000;
+	} while(left > 0);
+
+	// Nothing is outstanding here, so any handlers are free to use
+	// the bus
+	if (m_intvec)
+		dispatch();
+}
+
+/*
+ * set_handler()
+ *
+ * Register a function to be called with each report of the given interrupt
+ * line, or remove it by passing NULL.
+ */
+void	HEXBUS::set_handler(unsigned line, INTHANDLER fn, void *data) {
+	if (line >= HEXB_MAXINTS)
+		return;
+	m_inthandler[line] = fn;
+	m_intdata[line] = data;
+}
+
+/*
+ * dispatch()
+ *
+ * Call the handler of every interrupt line reported since the last dispatch,
+ * and clear those lines.  Lines without a handler remain set, for the caller
+ * to find with interrupts().  Returns the lines handled.
+ */
+unsigned	HEXBUS::dispatch(void) {
+	unsigned	handled = 0;
+
+	for(unsigned k=0; k<HEXB_MAXINTS; k++)
+		if ((m_intvec & (1u<<k))&&(m_inthandler[k]))
+			handled |= (1u<<k);
+
+	// Clear these lines first, so that a handler may notice its own line
+	// being raised again
+	m_intvec &= ~handled;
+	for(unsigned k=0; k<HEXB_MAXINTS; k++)
+		if (handled & (1u<<k))
+			m_inthandler[k](k, m_intdata[k]);
+
+	return handled;
 }
 
 /*
  * wait()
  *
- * Wait for an interrupt condition.
+ * Wait for an interrupt condition.  We sleep in poll() until something
+ * arrives, and so wake as soon as the interrupt does.
  */
 void	HEXBUS::wait(void) {
-	if (m_interrupt_flag)
+	if (m_interrupt_flag) {
 		DBGPRINTF("INTERRUPTED PRIOR TO WAIT()\n");
-	do {
-		// Here's where the real work is getting done
-		usleep(200);
-	} while(!m_interrupt_flag);
+		usleep(0);
+	} else
+		usleep(LLCOMMS_FOREVER);
 }
 
 // HEXBUS:  3503421 ~= 3.3 MB, stopwatch = 1:18.5 seconds, vs 53.8 secs
@@ -46,51 +46,352 @@
 #ifndef	HEXBUS_H
 #define	HEXBUS_H
 
+#include <deque>
+
 #include "llcomms.h"
 #include "devbus.h"
 
 extern	bool	gbl_last_readidle;
 
+// HEXB_RDWINDOW
+//
+// The default number of read requests that readv() will allow to be in flight
+// at any given time.  Since every request is paced (below) so that it takes
+// at least as long to send as its response takes to return, the hbexec/hbpack
+// input path never sees requests faster than it can answer them.  The window
+// then only needs to cover the round trip latency of the link.
+#define	HEXB_RDWINDOW	16
+
+// HEXB_WRWINDOW
+//
+// The default number of write credits.  writev() will stream writes until
+// this many command words are outstanding before it stops to collect their
+// acknowledgements.  Each write costs one word, plus one for any byte enables
+// or address sent ahead of it.
+#define	HEXB_WRWINDOW	16
+
+// HEXB_PACE
+//
+// The longest response to a single request is an 'R' followed by eight hex
+// digits, a carriage return and a newline.  Requests are padded out with
+// (ignored) newlines to this length, so that the return channel within the
+// FPGA never overflows.  This isn't needed once the FPGA reports a command
+// FIFO, see HEXBUS::capabilities().
+#define	HEXB_PACE	11
+
+// HEXB_MAXIDLES
+//
+// How many idles in a row we'll wait through for a response before deciding
+// the FPGA has hung
+#define	HEXB_MAXIDLES	3
+
+// Special commands, 'S' followed by an argument in bits [31:4] and the command
+// in bits [3:0]
+#define	HEXB_SPC_CAPS	0	// Capability query
+#define	HEXB_SPC_BURST	1	// Burst read, argument is the number of words
+#define	HEXB_SPC_MODE	2	// Switch protocols, argument is HEXB_MODE_*
+#define	HEXB_SPC_SEL	3	// Byte enables of the next write
+#define	HEXB_SPC_POLL	4	// Poll, argument is the timeout in clocks
+#define	HEXB_SPC_CRC	5	// CRC32, argument is the number of words
+#define	HEXB_SPC_FILL	6	// Fill, argument is the number of words
+#define	HEXB_SPC_COPY	7	// Copy, argument is the number of words
+// The longest burst that can be requested with one command
+#define	HEXB_MAXBURST	0x0fffffff
+// The longest poll timeout, in clocks
+#define	HEXB_MAXPOLL	0x0fffffff
+// Arguments to the mode switch, any combination of which may be selected
+#define	HEXB_MODE_HEX		0
+#define	HEXB_MODE_BINARY	1	// The binary protocol, see binbus.cpp
+#define	HEXB_MODE_RLE		2	// Compress repeated read responses
+
+// Capability bits, as returned by HEXBUS::capabilities().  An FPGA that
+// doesn't understand the capability query reports none of these.
+#define	HEXB_CAP_QUERY	(1<<HEXB_SPC_CAPS)
+#define	HEXB_CAP_BURST	(1<<HEXB_SPC_BURST)
+#define	HEXB_CAP_MODE	(1<<HEXB_SPC_MODE)
+#define	HEXB_CAP_SEL	(1<<HEXB_SPC_SEL)
+#define	HEXB_CAP_POLL	(1<<HEXB_SPC_POLL)
+#define	HEXB_CAP_CRC	(1<<HEXB_SPC_CRC)
+#define	HEXB_CAP_FILL	(1<<HEXB_SPC_FILL)
+#define	HEXB_CAP_COPY	(1<<HEXB_SPC_COPY)
+// Which modes the mode switch may turn on
+#define	HEXB_CAP_BINARY	(HEXB_MODE_BINARY<<24)
+#define	HEXB_CAP_RLE	(HEXB_MODE_RLE<<24)
+// Log, base two, of the depth of the FPGA's command FIFO, or zero if it has none
+#define	HEXB_CAP_LGFIFO(C)	(((C)>>16)&0x0f)
+// Log, base two, of the number of bus requests the FPGA may have outstanding
+#define	HEXB_CAP_LGPIPE(C)	(((C)>>20)&0x0f)
+
+// The most interrupt lines an FPGA may report, see hbints.v
+#define	HEXB_MAXINTS	29
+
+// HEXDECODER
+//
+// An incremental decoder for the characters returned from the FPGA.  It can
+// be handed any number of characters at a time, and keeps its state from one
+// call to the next, so responses may be split across calls anywhere.  Each
+// call stops at the first complete response it finds and returns it as an
+// event, together with its (hexadecimal) value.
+//
+// The decoder may also be switched to the binary protocol, see binbus.cpp.
+// A reset returns it to hexadecimal, as it does the FPGA.
+//
+// An EV_REPEAT event, whose value is a count, means the last read response
+// was repeated that many more times.  The FPGA only sends these once asked
+// to, see HEXB_MODE_RLE.
+class	HEXDECODER {
+public:
+	typedef	enum	{ EV_NONE=0, EV_ADDR, EV_READ, EV_ACK, EV_INT, EV_ERR,
+			EV_RESET, EV_IDLE, EV_MODE, EV_REPEAT } EVENT;
+	// Implementations of readrun(), from slowest to fastest
+	typedef	enum	{ RUN_SCALAR=0, RUN_SSE2, RUN_AVX2 } RUNIMPL;
+private:
+	unsigned	m_word;
+	char		m_cmd;
+	// m_empty is true if no digits have been received since the last
+	// response ended
+	bool		m_isspace, m_empty;
+	// In binary mode, m_esc is true following an escape, and m_nbytes
+	// counts the bytes remaining in the current word
+	bool		m_binary, m_esc;
+	unsigned	m_nbytes;
+
+	EVENT	bindecode(const char *buf, unsigned len, unsigned &used,
+			unsigned &v);
+	unsigned binrun(const char *buf, unsigned len, unsigned &used,
+			unsigned *vals, unsigned maxv);
+public:
+	HEXDECODER(void) : m_binary(false) { reset(); }
+	void	reset(void) { m_word = 0; m_cmd = 0; m_isspace = true;
+			m_empty = true; m_esc = false; m_nbytes = 0; }
+
+	void	set_binary(bool b) { m_binary = b; reset(); }
+	bool	binary(void) const { return m_binary; }
+
+	// Decode up to len characters from buf.  The number actually consumed
+	// is returned in used.  If a response was completed, its event is
+	// returned and its value placed into v.  Otherwise, EV_NONE is
+	// returned and all len characters will have been used.
+	EVENT	decode(const char *buf, unsigned len, unsigned &used,
+			unsigned &v);
+
+	// Decode a run of back to back read responses, each an 'R' followed
+	// by eight hexadecimal digits, directly into up to maxv words of vals.
+	// Returns the number of words decoded, and the number of characters
+	// used.  This stops at the first thing that isn't part of such a run,
+	// leaving it for decode() to deal with.
+	unsigned readrun(const char *buf, unsigned len, unsigned &used,
+			unsigned *vals, unsigned maxv);
+
+	// True if readrun() can decode anything at all.  Binary runs always
+	// can, but hexadecimal ones need one of the SIMD implementations.
+	// Otherwise, calling it would only slow decode() down.
+	bool	hasrun(void) const;
+
+	// Which implementation readrun() uses.  The fastest one the CPU
+	// supports is chosen by default.  set_runimpl() returns false if the
+	// one asked for isn't supported.
+	static	RUNIMPL	get_runimpl(void);
+	static	bool	set_runimpl(RUNIMPL impl);
+};
+
+// HEXENCODER
+//
+// Formats commands for the FPGA into a growable buffer, owned by the caller
+// and reused from one batch of commands to the next.  Once the buffer has
+// grown large enough, no further allocations are made.  Hexadecimal values
+// are written from a lookup table, without leading zeros, and every command
+// is paced (see HEXB_PACE above).  The buffer is always NUL terminated.
+//
+// Once switched to binary, commands are instead encoded as binary frames, see
+// binbus.cpp.
+class	HEXENCODER {
+	char		*m_buf;
+	unsigned	m_len, m_size, m_pace;
+	bool		m_binary;
+	// One past the position of the header of the last binary write frame,
+	// if further writes may still be added to it, or zero otherwise
+	unsigned	m_wrhdr;
+
+	void	grow(unsigned len);
+	char	*hex(char *ptr, unsigned v);
+	void	pace(unsigned start);
+
+	// Binary mode
+	void	binpace(unsigned start);
+	void	frame(unsigned hdr, unsigned v);
+	void	binread(void);
+	void	binwrite(unsigned v);
+public:
+	HEXENCODER(void) : m_buf(NULL), m_len(0), m_size(0), m_pace(HEXB_PACE),
+			m_binary(false), m_wrhdr(0)
+		{ grow(64); }
+	~HEXENCODER(void) { if (m_buf) delete[] m_buf; }
+
+	// Make room for len more characters
+	void	reserve(unsigned len) {
+		if (m_len + len >= m_size)
+			grow(m_len + len + 1);
+	}
+	void	clear(void) { m_len = 0; m_buf[0] = '\0'; m_wrhdr = 0; }
+	char	*data(void) { return m_buf; }
+	unsigned size(void) const { return m_len; }
+	unsigned capacity(void) const { return m_size; }
+
+	// The number of hex digits needed to send v, leading zeros omitted
+	static	unsigned hexlen(unsigned v) {
+		return (v == 0) ? 0 : (35 - __builtin_clz(v)) >> 2; }
+
+	// The number of digits, or in binary bytes, needed to send v
+	unsigned cost(unsigned v) const {
+		return (m_binary) ? ((hexlen(v)+1)>>1) : hexlen(v); }
+
+	// Switch to, or from, the binary protocol
+	void	set_binary(bool b) { m_binary = b; m_wrhdr = 0; }
+	bool	binary(void) const { return m_binary; }
+
+	// The minimum length of any command, newlines included
+	void	set_pace(unsigned p) { m_pace = p; }
+	unsigned get_pace(void) const { return m_pace; }
+
+	// Append a command to the buffer
+	void	address(unsigned a);
+	void	read(void);
+	void	write(unsigned v);
+	void	special(unsigned cmd, unsigned arg);
+};
+
 class	HEXBUS : public DEVBUS {
 public:
 	unsigned long	m_total_nread;
-private:
+	// An interrupt handler, called with the line that was reported
+	typedef	void	(*INTHANDLER)(unsigned line, void *data);
+protected:
 	LLCOMMSI	*m_dev;
 
 	bool	m_interrupt_flag, m_addr_set, m_bus_err;
-	unsigned int	m_lastaddr, m_nacks;
-	bool		m_inc, m_isspace;
+	unsigned int	m_lastaddr, m_nacks, m_nwrites;
+	bool		m_inc;
+	// The address of every write sent but not yet answered, oldest first,
+	// so that a bus error can be blamed on the write that caused it
+	std::deque<BUSW>	m_wraddr;
+	// How many command words each of those writes cost, counting any
+	// address or byte enables sent ahead of it, and their sum.  None of
+	// them can still be in the FPGA's command FIFO once the write has
+	// been answered.
+	std::deque<unsigned>	m_wrcost;
+	unsigned		m_wrslots;
+	// True if writes return without waiting for their acknowledgements
+	bool		m_posted;
+	// The first write to fail, should that failure arrive where it can't
+	// be reported--such as while sleeping.  The next fence() reports it.
+	bool		m_posted_err;
+	BUSW		m_posted_erraddr;
+	// The interrupt lines reported, but not yet handled, and their
+	// handlers
+	unsigned	m_intvec;
+	INTHANDLER	m_inthandler[HEXB_MAXINTS];
+	void		*m_intdata[HEXB_MAXINTS];
+	// Where the bus address will be once all requests sent so far
+	// complete
+	unsigned int	m_txaddr;
+	bool		m_txinc;
+	unsigned	m_rdwindow, m_wrwindow;
+	// What the FPGA supports, once we've asked
+	unsigned	m_caps, m_fifolen;
+	bool		m_caps_valid;
+	// The HEXB_MODE_* bits the FPGA has been switched to
+	unsigned	m_mode;
+	// The last word read, and how many more copies of it the FPGA has
+	// told us about (EV_REPEAT) that haven't yet been returned
+	BUSW		m_lastread;
+	unsigned	m_repeat;
+
+	// Commands are built here before being sent
+	HEXENCODER	m_enc;
 
-	int	m_buflen;
-	char	*m_buf, m_cmd;
+	// The decoder, which reads straight out of m_dev's receive ring
+	HEXDECODER	m_dec;
 
 	void	init(void) {
 		m_total_nread = 0;
 		m_interrupt_flag = false;
-		m_buflen = 0; m_buf = NULL;
 		m_addr_set = false;
-		bufalloc(64);
+		m_txaddr = 0; m_txinc = true;
 		m_bus_err    = false;
-		m_cmd = 0;
 		m_nacks = 0;
+		m_nwrites = 0;
+		m_wraddr.clear();
+		m_wrcost.clear(); m_wrslots = 0;
+		m_posted = false;
+		m_posted_err = false; m_posted_erraddr = 0;
+		m_intvec = 0;
+		for(unsigned k=0; k<HEXB_MAXINTS; k++) {
+			m_inthandler[k] = NULL;
+			m_intdata[k] = NULL;
+		}
+		m_rdwindow = HEXB_RDWINDOW;
+		m_wrwindow = HEXB_WRWINDOW;
+		m_caps = 0; m_caps_valid = false; m_fifolen = 0;
+		m_mode = HEXB_MODE_HEX;
+		m_lastread = 0; m_repeat = 0;
 		gbl_last_readidle = true;
 	}
 
-	void	bufalloc(int len);
-	BUSW	readword(void); // Reads a word value from the bus
+	// Reads a word value from the bus
+	BUSW	readword(const unsigned maxidles = HEXB_MAXIDLES);
+	int	readwords(const int len, BUSW *buf);
+	int	readresponse(BUSW &v, const unsigned maxidles = HEXB_MAXIDLES);
 	void	readv(const BUSW a, const int inc, const int len, BUSW *buf);
-	void	writev(const BUSW a, const int p, const int len, const BUSW *buf);
+	void	writev(const BUSW a, const int p, const int len, const BUSW *buf,
+			const unsigned sel = 0x0f);
 	void	readidle(void);
+	void	drain(unsigned slots);
+	void	blockop(const BUSW a, const int len);
 
-	int	lclreadcode(char *buf, int len);
-	char	*encode_address(const BUSW a);
+	// Count a write to address a as sent, together with the cost of the
+	// command words it took
+	void	wrsent(const BUSW a, const unsigned cost = 1) {
+		m_nwrites++;
+		m_wraddr.push_back(a);
+		m_wrcost.push_back(cost);
+		m_wrslots += cost;
+	}
+	// Note a write as failed, unless an earlier failure is still waiting
+	// to be reported
+	void	wrfailed(const BUSW a) {
+		if (!m_posted_err) {
+			m_posted_err = true;
+			m_posted_erraddr = a;
+		}
+	}
+
+	// Count the oldest write sent as answered, returning its address
+	BUSW	ackwrite(void) {
+		BUSW	a = m_lastaddr;
+
+		m_nacks++;
+		if (!m_wraddr.empty()) {
+			a = m_wraddr.front();
+			m_wraddr.pop_front();
+			m_wrslots -= m_wrcost.front();
+			m_wrcost.pop_front();
+		}
+		return a;
+	}
+
+	bool	rxfill(unsigned ms);
+	HEXDECODER::EVENT	nextevent(BUSW &v, bool block);
+	void	encode_address(const BUSW a);
+	unsigned window(unsigned w) const {
+		if (w < 1)
+			return 1;
+		return ((m_fifolen)&&(w > m_fifolen)) ? m_fifolen : w;
+	}
 public:
 	HEXBUS(LLCOMMSI *comms) : m_dev(comms) { init(); }
 	virtual	~HEXBUS(void) {
 		m_dev->close();
-		if (m_buf)
-			delete[] m_buf;
-		m_buf = NULL;
 		delete	m_dev;
 	}
 
@@ -102,12 +403,65 @@ public:
 	void	readz( const BUSW a, const int len, BUSW *buf);
 	void	writei(const BUSW a, const int len, const BUSW *buf);
 	void	writez(const BUSW a, const int len, const BUSW *buf);
+	void	writes(const BUSW a, const unsigned sel, const BUSW v);
+	BUSW	readuntil(const BUSW a, const BUSW mask, const BUSW expect,
+			const unsigned timeout, const unsigned clkhz);
+	using	DEVBUS::crc32;
+	BUSW	crc32(const BUSW a, const int len);
+	void	fill(const BUSW a, const int len, const BUSW v);
+	void	copy(const BUSW dst, const BUSW src, const int len);
+	void	flush(BUSBATCH &b);
 	bool	poll(void) { return m_interrupt_flag; };
 	void	usleep(unsigned msec); // Sleep until interrupt
 	void	wait(void); // Sleep until interrupt
+
+	// The file descriptor responses arrive on.  A program with more than
+	// the FPGA to wait on may poll this along with everything else, and
+	// then call usleep(0) whenever it's readable.  Any interrupt arriving
+	// will then be noted, and its handler called.  Call usleep(0) before
+	// waiting as well, since that also pushes out anything (such as
+	// posted writes) still queued for the device.
+	int	fd(void) const { return m_dev->fd(); }
 	bool	bus_err(void) const { return m_bus_err; };
 	void	reset_err(void) { m_bus_err = false; }
-	void	clear(void) { m_interrupt_flag = false; }
+	void	clear(void) { m_interrupt_flag = false; m_intvec = 0; }
+
+	// The interrupt lines reported since last handled or cleared.  An
+	// FPGA with a single interrupt line reports it as line zero.
+	unsigned interrupts(void) const { return m_intvec; }
+	// Call fn(line, data) for each report of the given line, or NULL to
+	// stop.  Handlers are called from dispatch(), which usleep() and
+	// wait() call whenever an interrupt has been reported.
+	void	set_handler(unsigned line, INTHANDLER fn, void *data = NULL);
+	unsigned dispatch(void);
+
+	// Set the number of read requests that may be outstanding at once.
+	// A window of one returns us to one round trip per word.  If the FPGA
+	// has a command FIFO, both windows are set to its depth once its
+	// capabilities are known, and may not be set any larger.  Every
+	// command word then counts against them, addresses included, so that
+	// the FIFO never overflows.
+	void	set_read_window(unsigned w) { m_rdwindow = window(w); }
+	unsigned get_read_window(void) const { return m_rdwindow; }
+
+	// Set the number of write credits: how many command words of writes
+	// may be sent before we stop to wait for their acknowledgements.
+	void	set_write_window(unsigned w) { m_wrwindow = window(w); }
+	unsigned get_write_window(void) const { return m_wrwindow; }
+
+	// Posted writes, see DEVBUS.  fence() waits for every write we've
+	// sent to be acknowledged.
+	void	set_posted(const bool on) {
+		if ((m_posted)&&(!on))
+			fence();
+		m_posted = on;
+	}
+	bool	posted(void) const { return m_posted; }
+	void	fence(void);
+
+	// The HEXB_CAP_* bits the FPGA supports.  The FPGA is only asked the
+	// first time, the answer is then kept.
+	virtual	unsigned capabilities(void);
 };
 
 typedef	HEXBUS	FPGA;
@@ -0,0 +1,354 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	hexrun.cpp
+// {{{
+// Project:	dbgbus, a collection of 8b channel to WB bus debugging protocols
+//
+// Purpose:	A fast path for decoding long runs of read responses, such as
+//		those returned from bulk readi()/readz() calls.  Rather than
+//	processing each character in turn, the characters are classified
+//	64 at a time into bit masks (using SSE2 or AVX2 where available), and
+//	whole "Rxxxxxxxx" responses are then validated and converted at once.
+//
+//	This code does not run on an FPGA, is not a test bench, neither is it a
+//	simulator.  It is a portion of a command program for commanding an FPGA.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2024, Gisselquist Technology, LLC
+// {{{
+// This file is part of the hexbus debugging interface.
+//
+// The hexbus interface is free software (firmware): you can redistribute it
+// and/or modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// The hexbus interface is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  (It's in the $(ROOT)/doc directory.  Run make
+// with no target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	LGPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/lgpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdint.h>
+
+#if	defined(__x86_64__) || defined(__i386__)
+#if	defined(__GNUC__) && defined(__SSE2__)
+#define	HEXRUN_X86
+#include <immintrin.h>
+#endif
+#endif
+
+#include "hexbus.h"
+
+#define	HEXB_READ	'R'
+
+// The number of characters classified at once
+#define	RUNWINDOW	64
+
+// RUNMASK
+//
+// One bit per character of a window: is it a (lower case) hexadecimal digit,
+// is it white space, and is it the start of a read response?
+typedef	struct {
+	uint64_t	hex, sp, rd;
+} RUNMASK;
+
+typedef	void	(*CLASSIFYFN)(const char *, unsigned, RUNMASK &);
+typedef	unsigned (*CONVERTFN)(const char *);
+
+// classify_scalar
+// {{{
+// The SIMD classifiers below only handle whole windows.  This one handles
+// whatever is left over at the end of a buffer.
+//
+// Bit 0: hexadecimal digit, bit 1: white space, bit 2: read response
+static	unsigned char	runclass[256];
+
+static	void	classify_scalar(const char *buf, unsigned len, RUNMASK &m) {
+	uint64_t	hex = 0, sp = 0, rd = 0;
+
+	for(unsigned k=0; k<len; k++) {
+		uint64_t	cls = runclass[(unsigned char)buf[k]];
+
+		hex |= (cls & 1) << k;
+		sp  |= ((cls >> 1) & 1) << k;
+		rd  |= (cls >> 2) << k;
+	}
+
+	m.hex = hex; m.sp = sp; m.rd = rd;
+}
+
+static	void	mkrunclass(void) {
+	for(int k=0; k<256; k++) {
+		if (((k >= '0')&&(k <= '9'))||((k >= 'a')&&(k <= 'f')))
+			runclass[k] = 1;
+		else if ((k == ' ')||((k >= '\t')&&(k <= '\r')))
+			runclass[k] = 2;
+		else if (k == HEXB_READ)
+			runclass[k] = 4;
+		else
+			runclass[k] = 0;
+	}
+}
+// }}}
+
+#ifdef	HEXRUN_X86
+// classify_sse2
+// {{{
+// Signed byte comparisons are fine here: anything with its top bit set
+// compares as negative, and so fails every range check.
+static	inline	uint64_t	sse2_mask(const __m128i v,
+		const __m128i lo, const __m128i hi) {
+	return _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(v, lo),
+			_mm_cmplt_epi8(v, hi)));
+}
+
+static	void	classify_sse2(const char *buf, unsigned len, RUNMASK &m) {
+	if (len < RUNWINDOW) {
+		classify_scalar(buf, len, m);
+		return;
+	}
+
+	const __m128i	dlo = _mm_set1_epi8('0'-1), dhi = _mm_set1_epi8('9'+1),
+			alo = _mm_set1_epi8('a'-1), ahi = _mm_set1_epi8('f'+1),
+			clo = _mm_set1_epi8('\t'-1),chi = _mm_set1_epi8('\r'+1),
+			spc = _mm_set1_epi8(' '),   rdc = _mm_set1_epi8(HEXB_READ);
+
+	m.hex = m.sp = m.rd = 0;
+	for(unsigned k=0; k<RUNWINDOW; k+= 16) {
+		__m128i	v = _mm_loadu_si128((const __m128i *)&buf[k]);
+		uint64_t	hex, sp, rd;
+
+		hex = sse2_mask(v, dlo, dhi) | sse2_mask(v, alo, ahi);
+		sp  = sse2_mask(v, clo, chi)
+			| _mm_movemask_epi8(_mm_cmpeq_epi8(v, spc));
+		rd  = _mm_movemask_epi8(_mm_cmpeq_epi8(v, rdc));
+
+		m.hex |= hex << k;
+		m.sp  |= sp  << k;
+		m.rd  |= rd  << k;
+	}
+}
+// }}}
+
+// classify_avx2
+// {{{
+__attribute__((target("avx2")))
+static	inline	uint64_t	avx2_mask(const __m256i v,
+		const __m256i lo, const __m256i hi) {
+	return (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(
+			_mm256_cmpgt_epi8(v, lo), _mm256_cmpgt_epi8(hi, v)));
+}
+
+__attribute__((target("avx2")))
+static	void	classify_avx2(const char *buf, unsigned len, RUNMASK &m) {
+	if (len < RUNWINDOW) {
+		classify_scalar(buf, len, m);
+		return;
+	}
+
+	const __m256i	dlo = _mm256_set1_epi8('0'-1), dhi = _mm256_set1_epi8('9'+1),
+			alo = _mm256_set1_epi8('a'-1), ahi = _mm256_set1_epi8('f'+1),
+			clo = _mm256_set1_epi8('\t'-1),chi = _mm256_set1_epi8('\r'+1),
+			spc = _mm256_set1_epi8(' '),   rdc = _mm256_set1_epi8(HEXB_READ);
+
+	m.hex = m.sp = m.rd = 0;
+	for(unsigned k=0; k<RUNWINDOW; k+= 32) {
+		__m256i	v = _mm256_loadu_si256((const __m256i *)&buf[k]);
+		uint64_t	hex, sp, rd;
+
+		hex = avx2_mask(v, dlo, dhi) | avx2_mask(v, alo, ahi);
+		sp  = avx2_mask(v, clo, chi)
+			| (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, spc));
+		rd  = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, rdc));
+
+		m.hex |= hex << k;
+		m.sp  |= sp  << k;
+		m.rd  |= rd  << k;
+	}
+}
+// }}}
+
+// convert_sse2
+// {{{
+// Converts all eight (already validated) digits at once.  Each digit's value
+// is its bottom four bits, plus nine if it is a letter (bit 6 set).  Pairs of
+// digits are then merged into bytes, most significant digit first.
+static	unsigned	convert_sse2(const char *buf) {
+	const __m128i	lsb = _mm_set1_epi8(0x0f), one = _mm_set1_epi8(1),
+			lobyte = _mm_set1_epi16(0x0ff);
+	__m128i	v, nib, alpha, pair;
+
+	v = _mm_loadl_epi64((const __m128i *)buf);
+	alpha = _mm_and_si128(_mm_srli_epi16(v, 6), one);
+	nib   = _mm_add_epi8(_mm_and_si128(v, lsb),
+			_mm_add_epi8(_mm_slli_epi16(alpha, 3), alpha));
+	pair  = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(nib, 4), lobyte),
+			_mm_srli_epi16(nib, 8));
+
+	return __builtin_bswap32(_mm_cvtsi128_si32(_mm_packus_epi16(pair, pair)));
+}
+// }}}
+#endif
+
+static	HEXDECODER::RUNIMPL	runimpl;
+static	CLASSIFYFN		classify = NULL;
+static	CONVERTFN		convert  = NULL;
+
+HEXDECODER::RUNIMPL	HEXDECODER::get_runimpl(void) {
+	if (!classify) {
+#ifdef	HEXRUN_X86
+		if (__builtin_cpu_supports("avx2"))
+			set_runimpl(RUN_AVX2);
+		else
+			set_runimpl(RUN_SSE2);
+#else
+		set_runimpl(RUN_SCALAR);
+#endif
+	}
+
+	return runimpl;
+}
+
+bool	HEXDECODER::set_runimpl(RUNIMPL impl) {
+	// Every implementation uses the scalar classifier for the last
+	// few characters of a buffer
+	if (0 == runclass[(int)'0'])
+		mkrunclass();
+
+	switch(impl) {
+	case RUN_SCALAR:
+		// Without SIMD, building the masks costs more than
+		// decode() does, so readrun() leaves everything to it.
+		classify = classify_scalar;
+		convert  = NULL;
+		break;
+#ifdef	HEXRUN_X86
+	case RUN_SSE2:
+		classify = classify_sse2;
+		convert  = convert_sse2;
+		break;
+	case RUN_AVX2:
+		if (!__builtin_cpu_supports("avx2"))
+			return false;
+		classify = classify_avx2;
+		convert  = convert_sse2;
+		break;
+#endif
+	default:
+		return false;
+	}
+
+	runimpl = impl;
+	return true;
+}
+
+bool	HEXDECODER::hasrun(void) const {
+	if (m_binary)
+		return true;
+	if (!classify)
+		get_runimpl();
+	return (convert != NULL);
+}
+
+/*
+ * HEXDECODER::readrun
+ *
+ * Walks through buf, RUNWINDOW characters at a time, following the bit masks
+ * from one response to the next.  A response is accepted if it is exactly
+ * eight digits long.  The character ending it then tells us where the next
+ * one starts: immediately, if it is another 'R', or after any white space.
+ * Anything else stops the run and is left for decode().
+ */
+unsigned HEXDECODER::readrun(const char *buf, unsigned len, unsigned &used,
+		unsigned *vals, unsigned maxv) {
+	RUNMASK		m;
+	unsigned	p = 0, base = 0, wlen = 0, o, n = 0;
+
+	// Binary runs need no classification at all
+	if (m_binary)
+		return binrun(buf, len, used, vals, maxv);
+
+	used = 0;
+	if (!classify)
+		get_runimpl();
+	if (!convert)
+		return 0;
+
+	// We can only start in between responses, or right after an 'R'
+	if ((!m_empty)||((!m_isspace)&&(m_cmd != HEXB_READ)))
+		return 0;
+
+	while(n < maxv) {
+		// Make certain the window covers at least the next response
+		o = p - base;
+		if ((o + 10 > wlen)&&(base + wlen < len)) {
+			base = p; o = 0;
+			wlen = len - p;
+			if (wlen > RUNWINDOW)
+				wlen = RUNWINDOW;
+			classify(&buf[p], wlen, m);
+		}
+
+		if (o >= wlen)
+			break;
+
+		if (m_isspace) {
+			// Skip any white space, and the 'R' following
+			uint64_t	rest = ~(m.sp >> o);
+			unsigned	k = (rest) ? __builtin_ctzll(rest)
+						: RUNWINDOW - o;
+
+			if (o + k >= wlen) {
+				p = base + wlen;
+				continue;
+			}
+
+			p += k; o += k;
+			if (0 == ((m.rd >> o)&1))
+				break;
+			m_cmd = HEXB_READ;
+			m_isspace = false;
+			p++;
+			continue;
+		}
+
+		if (m_cmd != HEXB_READ)
+			break;
+
+		// Eight digits, followed by something that isn't
+		if ((o + 9 > wlen)||(((m.hex >> o) & 0x1ff) != 0x0ff))
+			break;
+
+		// Idle inserts must be dropped, leave them to decode()
+		char	ch = buf[p+8];
+		if ((ch & 0x7f) == 0x7f)
+			break;
+
+		vals[n++] = convert(&buf[p]);
+		p += 9;
+
+		if ((m.sp >> (o+8))&1)
+			m_isspace = true;
+		else
+			m_cmd = ch;
+	}
+
+	used = p;
+	return n;
+}
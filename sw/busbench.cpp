@@ -0,0 +1,331 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	busbench.cpp
+// {{{
+// Project:	dbgbus, a collection of 8b channel to WB bus debugging protocols
+//
+// Purpose:	Measures how quickly the host side of the debugging bus can
+//		process its traffic, apart from any time spent waiting on the
+//	FPGA.  A capture of the characters returned from the FPGA can be given
+//	on the command line, otherwise one is made up.  The capture is decoded
+//	once by the scalar decoder, and once by each block decoder this CPU
+//	supports.  All must agree, and the words per second of each is
+//	reported.
+//
+//	A batch of commands is then encoded, both with the HEXENCODER and
+//	with sprintf() as a reference, and the commands per second of each
+//	reported.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2017-2024, Gisselquist Technology, LLC
+// {{{
+// This file is part of the debugging interface demonstration.
+//
+// The debugging interface demonstration is free software (firmware): you can
+// redistribute it and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// This debugging interface demonstration is distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTIBILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+// General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  (It's in the $(ROOT)/doc directory.  Run make
+// with no target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	LGPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/lgpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "hexbus.h"
+
+// How many words to make up, if no capture is given
+#define	NWORDS		(1<<20)
+// How many commands to encode in each batch
+#define	NCMDS		4096
+// Minimum time to spend on any one measurement
+#define	MINSECONDS	0.5
+
+static	double	now(void) {
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// loadcapture
+// {{{
+static	void	loadcapture(const char *fname, std::vector<char> &cap) {
+	FILE	*fp;
+	char	buf[4096];
+	size_t	nr;
+
+	fp = fopen(fname, "r");
+	if (!fp) {
+		fprintf(stderr, "ERR: Could not open %s\n", fname);
+		perror("O/S Err:");
+		exit(EXIT_FAILURE);
+	}
+
+	while((nr = fread(buf, 1, sizeof(buf), fp)) > 0)
+		cap.insert(cap.end(), buf, buf+nr);
+	fclose(fp);
+}
+// }}}
+
+// makecapture
+// {{{
+// Make up a capture looking like that of a bulk read: an address, followed
+// by read responses.  Some are separated by newlines, as when the link goes
+// idle between them, others come back to back.
+static	void	makecapture(std::vector<char> &cap) {
+	char	buf[32];
+	int	ln;
+
+	ln = sprintf(buf, "A00004000\r\n");
+	cap.insert(cap.end(), buf, buf+ln);
+	for(unsigned k=0; k<NWORDS; k++) {
+		ln = sprintf(buf, "R%08x%s", (unsigned)rand(),
+			(k & 8) ? "\r\n" : "");
+		cap.insert(cap.end(), buf, buf+ln);
+	} cap.push_back('\r'); cap.push_back('\n');
+}
+// }}}
+
+// decode_scalar
+// {{{
+// Decode the capture one character at a time, one event at a time
+static	unsigned	decode_scalar(const std::vector<char> &cap,
+		unsigned *vals) {
+	HEXDECODER	dec;
+	unsigned	p = 0, used, v, n = 0;
+
+	while(p < cap.size()) {
+		if (HEXDECODER::EV_READ == dec.decode(&cap[p], cap.size()-p,
+					used, v))
+			vals[n++] = v;
+		p += used;
+	}
+
+	return n;
+}
+// }}}
+
+// decode_runs
+// {{{
+// Decode the capture as HEXBUS::readwords() would: in bulk where possible,
+// falling back to the scalar decoder otherwise
+static	unsigned	decode_runs(const std::vector<char> &cap,
+		unsigned *vals) {
+	HEXDECODER	dec;
+	unsigned	p = 0, used, v, n = 0, nw;
+
+	const bool	runs = dec.hasrun();
+
+	while(p < cap.size()) {
+		nw = 0;
+		if (runs) {
+			nw = dec.readrun(&cap[p], cap.size()-p, used, &vals[n],
+					cap.size());
+			p += used;
+			n += nw;
+		}
+		if (nw == 0) {
+			if (HEXDECODER::EV_READ == dec.decode(&cap[p],
+					cap.size()-p, used, v))
+				vals[n++] = v;
+			p += used;
+		}
+	}
+
+	return n;
+}
+// }}}
+
+// measure
+// {{{
+static	double	measure(unsigned (*fn)(const std::vector<char> &, unsigned *),
+		const std::vector<char> &cap, unsigned *vals, unsigned &nw) {
+	double		start, elapsed;
+	unsigned long	total = 0;
+
+	start = now();
+	do {
+		nw = fn(cap, vals);
+		total += nw;
+		elapsed = now() - start;
+	} while(elapsed < MINSECONDS);
+
+	return total / elapsed;
+}
+// }}}
+
+// encode_sprintf
+// {{{
+// Encode the batch as HEXBUS used to, with sprintf(), for comparison.  As
+// with writes, addresses are written without leading zeros here, so that the
+// two encodings can be compared.
+static	unsigned	encode_sprintf(const unsigned *vals, char *buf) {
+	char	*ptr = buf, *cmd;
+
+	for(unsigned k=0; k<NCMDS; k++) {
+		cmd = ptr;
+		if (k & 1)
+			*ptr++ = 'R';
+		else {
+			*ptr++ = ((k & 0x3ff) == 0) ? 'A' : 'W';
+			if (vals[k] != 0) {
+				sprintf(ptr, "%x", vals[k]);
+				ptr += strlen(ptr);
+			}
+		}
+
+		do {
+			*ptr++ = '\n';
+		} while(ptr - cmd < HEXB_PACE);
+	} *ptr = '\0';
+
+	return ptr - buf;
+}
+// }}}
+
+// encode_hex
+// {{{
+static	unsigned	encode_hex(const unsigned *vals, HEXENCODER &enc) {
+	enc.clear();
+	for(unsigned k=0; k<NCMDS; k++) {
+		if ((k & 0x3ff) == 0)
+			enc.address(vals[k]);
+		else if (k & 1)
+			enc.read();
+		else
+			enc.write(vals[k]);
+	}
+
+	return enc.size();
+}
+// }}}
+
+// encodebench
+// {{{
+static	bool	encodebench(void) {
+	unsigned	*vals, ln, nref;
+	char		*ref, *first;
+	HEXENCODER	enc;
+	double		start, elapsed, rate, base;
+	unsigned long	total, grown = 0;
+	bool		fail = false;
+
+	vals = new unsigned[NCMDS];
+	ref  = new char[NCMDS * (HEXB_PACE+10)];
+	for(unsigned k=0; k<NCMDS; k++) {
+		// Mix in some short values, as most register writes are
+		vals[k] = (unsigned)rand() >> (rand() & 31);
+		if ((k & 0x3ff) == 0)
+			vals[k] &= -4;
+	}
+
+	// sprintf() reference
+	total = 0;
+	start = now();
+	do {
+		nref = encode_sprintf(vals, ref);
+		total += NCMDS;
+		elapsed = now() - start;
+	} while(elapsed < MINSECONDS);
+	base = total / elapsed;
+	printf("%-12s %10.3f Mcmds/s\n", "sprintf()", base / 1e6);
+
+	// HEXENCODER, counting how often its buffer moves after the first
+	// batch
+	ln = encode_hex(vals, enc);
+	first = enc.data();
+	total = 0;
+	start = now();
+	do {
+		ln = encode_hex(vals, enc);
+		if (enc.data() != first)
+			grown++;
+		total += NCMDS;
+		elapsed = now() - start;
+	} while(elapsed < MINSECONDS);
+	rate = total / elapsed;
+	printf("%-12s %10.3f Mcmds/s, %5.2fx, %lu reallocations\n",
+		"HEXENCODER", rate / 1e6, rate / base, grown);
+
+	if ((ln != nref)||(0 != memcmp(ref, enc.data(), ln))) {
+		printf("ERR: HEXENCODER does not match sprintf()\n");
+		fail = true;
+	}
+
+	delete[] vals;
+	delete[] ref;
+
+	return fail;
+}
+// }}}
+
+int	main(int argc, char **argv) {
+	std::vector<char>	cap;
+	unsigned		*ref, *vals, nref, nw;
+	double			rate, base;
+	const char		*names[] = { "scalar", "SSE2", "AVX2" };
+	bool			fail = false;
+
+	if (argc > 2) {
+		printf("USAGE: busbench [capture-file]\n");
+		exit(EXIT_FAILURE);
+	} else if (argc == 2)
+		loadcapture(argv[1], cap);
+	else
+		makecapture(cap);
+
+	ref  = new unsigned[cap.size()+1];
+	vals = new unsigned[cap.size()+1];
+
+	base = measure(decode_scalar, cap, ref, nref);
+	printf("%-12s %10.3f Mwords/s\n", "decode()", base / 1e6);
+
+	for(int k=HEXDECODER::RUN_SCALAR; k<=HEXDECODER::RUN_AVX2; k++) {
+		if (!HEXDECODER::set_runimpl((HEXDECODER::RUNIMPL)k))
+			continue;
+
+		memset(vals, 0, sizeof(unsigned) * (cap.size()+1));
+		rate = measure(decode_runs, cap, vals, nw);
+		if ((nw != nref)||(0 != memcmp(ref, vals, nw*sizeof(unsigned)))) {
+			printf("ERR: readrun(%s) does not match decode()\n",
+				names[k]);
+			fail = true;
+		}
+
+		printf("readrun(%-4s) %10.3f Mwords/s, %5.2fx\n", names[k],
+			rate / 1e6, rate / base);
+	}
+
+	printf("%u words decoded\n\n", nref);
+
+	if (encodebench())
+		fail = true;
+
+	delete[] ref;
+	delete[] vals;
+
+	return (fail) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,273 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	devbus.cpp
+// {{{
+// Project:	dbgbus, a collection of 8b channel to WB bus debugging protocols
+//
+// Purpose:	Implements the bus agnostic portions of the DEVBUS interface:
+//		the BUSBATCH list of operations, and the default (one
+//	operation at a time) means of issuing such a batch.  Interfaces able to
+//	do better, by sending an entire batch at once, may override
+//	DEVBUS::flush().
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2024, Gisselquist Technology, LLC
+// {{{
+// This file is part of the debugging interface demonstration.
+//
+// The debugging interface demonstration is free software (firmware): you can
+// redistribute it and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// This debugging interface demonstration is distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTIBILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+// General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  (It's in the $(ROOT)/doc directory.  Run make
+// with no target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	LGPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/lgpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "devbus.h"
+
+// BUSBATCH::queue
+// {{{
+BUSBATCH::HANDLE	BUSBATCH::queue(const bool wr, const bool inc,
+		const BUSW a, const int len, const BUSW *wbuf, BUSW *rbuf,
+		const BUSW v) {
+	BUSOP	op;
+
+	op.m_write   = wr;
+	op.m_inc     = inc;
+	op.m_addr    = a;
+	op.m_len     = len;
+	op.m_wbuf    = wbuf;
+	op.m_rbuf    = rbuf;
+	op.m_value   = v;
+	op.m_done    = false;
+	op.m_err     = false;
+	op.m_erraddr = 0;
+
+	m_ops.push_back(op);
+	return (HANDLE)(m_ops.size()-1);
+}
+// }}}
+
+// Queueing operations
+// {{{
+BUSBATCH::HANDLE	BUSBATCH::writeio(const BUSW a, const BUSW v) {
+	return queue(true, false, a, 1, NULL, NULL, v);
+}
+
+BUSBATCH::HANDLE	BUSBATCH::readio(const BUSW a) {
+	return queue(false, false, a, 1, NULL, NULL, 0);
+}
+
+BUSBATCH::HANDLE	BUSBATCH::readi(const BUSW a, const int len, BUSW *buf) {
+	return queue(false, true, a, len, NULL, buf, 0);
+}
+
+BUSBATCH::HANDLE	BUSBATCH::readz(const BUSW a, const int len, BUSW *buf) {
+	return queue(false, false, a, len, NULL, buf, 0);
+}
+
+BUSBATCH::HANDLE	BUSBATCH::writei(const BUSW a, const int len,
+		const BUSW *buf) {
+	return queue(true, true, a, len, buf, NULL, 0);
+}
+
+BUSBATCH::HANDLE	BUSBATCH::writez(const BUSW a, const int len,
+		const BUSW *buf) {
+	return queue(true, false, a, len, buf, NULL, 0);
+}
+// }}}
+
+// BUSBATCH::flush
+// {{{
+void	BUSBATCH::flush(void) {
+	m_dev->flush(*this);
+}
+// }}}
+
+// BUSBATCH::err
+// {{{
+bool	BUSBATCH::err(void) const {
+	for(unsigned k=0; k<m_ops.size(); k++)
+		if (m_ops[k].m_err)
+			return true;
+	return false;
+}
+// }}}
+
+// DEVBUS::writes
+// {{{
+// The default partial word write: read the word, replace the bytes selected,
+// and write it back.
+void	DEVBUS::writes(const BUSW a, const unsigned sel, const BUSW v) {
+	BUSW	mask = 0;
+
+	for(int k=0; k<4; k++)
+		if (sel & (1<<k))
+			mask |= 0x0ffu << (8*k);
+
+	if (mask == 0)
+		return;
+	else if (mask == 0xffffffffu)
+		writeio(a, v);
+	else
+		writeio(a, (readio(a) & ~mask) | (v & mask));
+}
+// }}}
+
+// DEVBUS::readuntil
+// {{{
+// The default poll: read the word until it matches, or until timeout bus
+// clocks have passed.  We can't count clocks from here, so we turn them into
+// a deadline instead, given the rate of the bus clock.
+DEVBUS::BUSW	DEVBUS::readuntil(const BUSW a, const BUSW mask,
+		const BUSW expect, const unsigned timeout, const unsigned clkhz) {
+	struct	timespec	deadline, now;
+	unsigned long long	ns;
+	BUSW			v;
+
+	ns = (clkhz) ? (unsigned long long)timeout * 1000000000ull / clkhz : 0;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec  += ns / 1000000000ull;
+	deadline.tv_nsec += ns % 1000000000ull;
+	if (deadline.tv_nsec >= 1000000000l) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000l;
+	}
+
+	while(((v = readio(a)) & mask) != expect) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if ((now.tv_sec > deadline.tv_sec)
+				||((now.tv_sec == deadline.tv_sec)
+				&&(now.tv_nsec >= deadline.tv_nsec)))
+			break;
+	}
+
+	return v;
+}
+// }}}
+
+// DEVBUS::crc32
+// {{{
+// The default CRC reads the region, a block at a time, and computes its CRC
+// here
+DEVBUS::BUSW	DEVBUS::crc32(const BUSW a, const int len) {
+	const int	BLKLEN = 1024;
+	BUSW		buf[BLKLEN], crc = 0;
+
+	for(int k=0; k<len; k+=BLKLEN) {
+		int	ln = (len-k < BLKLEN) ? len-k : BLKLEN;
+
+		readi(a+(k<<2), ln, buf);
+		crc = crc32(buf, ln, crc);
+	}
+
+	return crc;
+}
+
+DEVBUS::BUSW	DEVBUS::crc32(const BUSW *buf, const int len, const BUSW crc) {
+	static	BUSW	table[256];
+	static	bool	table_valid = false;
+	BUSW		c = ~crc;
+
+	if (!table_valid) {
+		for(unsigned k=0; k<256; k++) {
+			BUSW	t = k;
+			for(int b=0; b<8; b++)
+				t = (t & 1) ? ((t >> 1) ^ 0xedb88320u) : (t >> 1);
+			table[k] = t;
+		}
+		table_valid = true;
+	}
+
+	for(int k=0; k<len; k++) {
+		for(int s=24; s>=0; s-=8)
+			c = table[(c ^ (buf[k] >> s)) & 0x0ff] ^ (c >> 8);
+	}
+
+	return ~c;
+}
+// }}}
+
+// DEVBUS::fill, DEVBUS::copy
+// {{{
+// The default fill and copy write the region from here, a block at a time
+void	DEVBUS::fill(const BUSW a, const int len, const BUSW v) {
+	const int	BLKLEN = 1024;
+	BUSW		buf[BLKLEN];
+
+	for(int k=0; k<BLKLEN; k++)
+		buf[k] = v;
+
+	for(int k=0; k<len; k+=BLKLEN) {
+		int	ln = (len-k < BLKLEN) ? len-k : BLKLEN;
+
+		writei(a+(k<<2), ln, buf);
+	}
+}
+
+void	DEVBUS::copy(const BUSW dst, const BUSW src, const int len) {
+	const int	BLKLEN = 1024;
+	BUSW		buf[BLKLEN];
+
+	for(int k=0; k<len; k+=BLKLEN) {
+		int	ln = (len-k < BLKLEN) ? len-k : BLKLEN;
+
+		readi(src+(k<<2), ln, buf);
+		writei(dst+(k<<2), ln, buf);
+	}
+}
+// }}}
+
+// DEVBUS::flush
+// {{{
+// The default batch implementation: issue each operation in turn, using
+// whatever the interface provides, and note any errors along the way.
+void	DEVBUS::flush(BUSBATCH &b) {
+	for(int k=0; k<b.size(); k++) {
+		BUSBATCH::BUSOP	&op = b[k];
+
+		if (op.m_done)
+			continue;
+
+		try {
+			if (op.m_write) {
+				if (op.m_inc)
+					writei(op.m_addr, op.m_len, op.wbuf());
+				else
+					writez(op.m_addr, op.m_len, op.wbuf());
+			} else if (op.m_inc)
+				readi(op.m_addr, op.m_len, op.rbuf());
+			else
+				readz(op.m_addr, op.m_len, op.rbuf());
+		} catch(BUSERR e) {
+			op.m_err = true;
+			op.m_erraddr = e.addr;
+		}
+
+		op.m_done = true;
+	}
+}
+// }}}
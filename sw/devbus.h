@@ -53,6 +53,7 @@
 
 #include <stdio.h>
 #include <unistd.h>
+#include <vector>
 
 typedef	unsigned int	uint32;
 
@@ -62,6 +63,79 @@ public:
 	BUSERR(const uint32 a) : addr(a) {};
 };
 
+class	DEVBUS;
+
+// BUSBATCH
+//
+// A list of bus operations that are to be issued together.  Each operation
+// queued returns a handle.  Nothing is sent until flush() is called, after
+// which the results of each operation may be found through its handle.
+// Interfaces that can, such as the HEXBUS, will send the entire batch as one
+// stream rather than paying a round trip for every operation.
+//
+// Bus errors do not abort the batch.  Instead, every operation is attempted
+// and any error is recorded against the operation that caused it.
+class	BUSBATCH {
+public:
+	typedef	uint32	BUSW;
+	typedef	int	HANDLE;
+
+	class	BUSOP {
+	public:
+		bool		m_write, m_inc;
+		BUSW		m_addr;
+		int		m_len;
+		// Caller's buffers, or NULL for single word operations,
+		// whose value is kept in m_value instead
+		const BUSW	*m_wbuf;
+		BUSW		*m_rbuf;
+		BUSW		m_value;
+		bool		m_done, m_err;
+		BUSW		m_erraddr;
+
+		BUSW	*rbuf(void) { return (m_rbuf) ? m_rbuf : &m_value; }
+		const BUSW *wbuf(void) const {
+			return (m_wbuf) ? m_wbuf : &m_value; }
+	};
+
+private:
+	DEVBUS			*m_dev;
+	std::vector<BUSOP>	m_ops;
+
+	HANDLE	queue(const bool wr, const bool inc, const BUSW a,
+			const int len, const BUSW *wbuf, BUSW *rbuf,
+			const BUSW v);
+public:
+	BUSBATCH(DEVBUS *dev) : m_dev(dev) {}
+
+	// Queue operations, with the same meanings as the DEVBUS calls of
+	// the same name
+	HANDLE	writeio(const BUSW a, const BUSW v);
+	HANDLE	readio(const BUSW a);
+	HANDLE	readi(const BUSW a, const int len, BUSW *buf);
+	HANDLE	readz(const BUSW a, const int len, BUSW *buf);
+	HANDLE	writei(const BUSW a, const int len, const BUSW *buf);
+	HANDLE	writez(const BUSW a, const int len, const BUSW *buf);
+
+	// Issue every operation not yet issued, and wait for them all to
+	// complete
+	void	flush(void);
+
+	// Forget every operation, invalidating all handles
+	void	clear(void) { m_ops.clear(); }
+
+	int	size(void) const { return (int)m_ops.size(); }
+	BUSOP	&operator[](const HANDLE h) { return m_ops[h]; }
+
+	// Results.  value() returns the word read by a readio operation.
+	BUSW	value(const HANDLE h) const { return m_ops[h].m_value; }
+	bool	done(const HANDLE h) const { return m_ops[h].m_done; }
+	bool	err(const HANDLE h) const { return m_ops[h].m_err; }
+	BUSW	erraddr(const HANDLE h) const { return m_ops[h].m_erraddr; }
+	// True if any operation in the batch failed
+	bool	err(void) const;
+};
+
 class	DEVBUS {
 public:
 	typedef	uint32	BUSW;
@@ -122,6 +196,56 @@ public:
 	//
 	virtual	void	writez(const BUSW a, const int len, const BUSW *buf) = 0;
 
+	// Write only some of the bytes of the word at address a.  Bit k of sel
+	// selects bits [8k+7:8k] of v, all others are left as they were.  The
+	// default implementation reads the word, and then writes it back
+	// modified.  Interfaces that can, such as the HEXBUS, write the
+	// selected bytes alone instead.
+	virtual	void	writes(const BUSW a, const unsigned sel, const BUSW v);
+
+	// Write a single byte, or halfword, to the byte address a.  The first
+	// byte of every word is in its most significant bits, as on the
+	// ZipCPU.  A little endian bus, such as AXI, should use writes()
+	// directly instead.
+	void	writeb(const BUSW a, const unsigned v) {
+		writes(a & -4, 8 >> (a&3), (v & 0x0ff) << (8*(3-(a&3)))); }
+	void	writeh(const BUSW a, const unsigned v) {
+		writes(a & -4, (a&2) ? 0x3 : 0xc,
+			(v & 0x0ffff) << ((a&2) ? 0 : 16)); }
+
+	// Read the word at address a until (value & mask) == expect, or until
+	// timeout bus clocks have passed, and return the last value read.  The
+	// caller checks that value to see which it was.  Interfaces that can,
+	// such as the HEXBUS, leave the polling to the FPGA, which counts the
+	// clocks itself.  The default implementation calls readio() instead,
+	// until that many clocks of a clkhz bus clock have passed on
+	// CLOCK_MONOTONIC.  It always reads at least once.
+	virtual	BUSW	readuntil(const BUSW a, const BUSW mask,
+				const BUSW expect, const unsigned timeout,
+				const unsigned clkhz);
+
+	// The CRC32 of the len words starting at address a, as computed by
+	// crc32(buf, len) below had they been read into buf.  Interfaces that
+	// can, such as the HEXBUS, have the FPGA compute this and return only
+	// the result.  The default implementation reads every word instead.
+	virtual	BUSW	crc32(const BUSW a, const int len);
+
+	// The common (IEEE 802.3, zlib) CRC32 of len words in buf, taking
+	// each word from its most significant byte to its least.  A CRC may
+	// be continued across several buffers by passing the last result in
+	// as crc.
+	static	BUSW	crc32(const BUSW *buf, const int len, const BUSW crc=0);
+
+	// Write v to each of the len words starting at address a, as
+	// writei() would from a buffer holding len copies of v
+	virtual	void	fill(const BUSW a, const int len, const BUSW v);
+
+	// Copy len words from address src to address dst.  As with memcpy(),
+	// the two regions must not overlap.  Interfaces that can, such as the
+	// HEXBUS, have the FPGA move the data for both of these.  The default
+	// implementations move every word through here instead.
+	virtual	void	copy(const BUSW dst, const BUSW src, const int len);
+
 	// Query whether or not an interrupt has taken place
 	virtual	bool	poll(void) = 0;
 
@@ -144,6 +268,24 @@ public:
 	// the interface, does not check for further interrupt
 	virtual	void	clear(void) = 0;
 
+	// Posted writes.  Once turned on, writes return as soon as they've
+	// been sent, rather than waiting to be acknowledged.  Those
+	// acknowledgements are then collected by the next fence(), or before
+	// the next read, and any bus error is reported there--against the
+	// address of the write that failed.  Turning posted writes off fences
+	// any still outstanding.  Interfaces without posted writes ignore
+	// this, and every write is then its own fence.
+	virtual	void	set_posted(const bool on) { }
+	virtual	bool	posted(void) const { return false; }
+
+	// Wait until every write sent has been acknowledged
+	virtual	void	fence(void) { }
+
+	// Issue every operation within a batch that hasn't yet been issued.
+	// The default implementation issues them one at a time, through the
+	// calls above.
+	virtual	void	flush(BUSBATCH &b);
+
 	virtual	~DEVBUS(void) { };
 };
 
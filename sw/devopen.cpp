@@ -0,0 +1,138 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	devopen.cpp
+// {{{
+// Project:	dbgbus, a collection of 8b channel to WB bus debugging protocols
+//
+// Purpose:	Turns a URI into a ready DEVBUS.  See devopen.h for the URIs
+//		understood.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2024, Gisselquist Technology, LLC
+// {{{
+// This file is part of the debugging interface demonstration.
+//
+// The debugging interface demonstration is free software (firmware): you can
+// redistribute it and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// This debugging interface demonstration is distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTIBILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+// General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  (It's in the $(ROOT)/doc directory.  Run make
+// with no target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	LGPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/lgpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "port.h"
+#include "llcomms.h"
+#include "hexbus.h"
+#include "binbus.h"
+#include "simbus.h"
+#include "devopen.h"
+
+static	void	devopen_err(const char *uri, const char *why) {
+	fprintf(stderr, "ERR: %s: %s\n", uri, why);
+	exit(EXIT_FAILURE);
+}
+
+DEVBUS	*devopen(const char *uri) {
+	char		dflt[256], *str, *path, *query, *opt, *sep, *colon;
+	const char	*host;
+	LLCOMMSI	*comms;
+	DEVBUS		*dev;
+	unsigned	baud = 0;
+	bool		binary = false;
+	int		port;
+
+	if ((!uri)||(!uri[0]))
+		uri = getenv("DBGBUS_URI");
+	if ((!uri)||(!uri[0])) {
+		sprintf(dflt, "tcp://%s:%d", FPGAHOST, FPGAPORT);
+		uri = dflt;
+	}
+
+	// Split the URI into its scheme, path, and options
+	// {{{
+	str = strdup(uri);
+	sep = strstr(str, "://");
+	if (!sep)
+		devopen_err(uri, "Not a URI, expecting scheme://path");
+	*sep = '\0';
+	path = sep + 3;
+
+	query = strchr(path, '?');
+	if (query)
+		*query++ = '\0';
+	for(opt = (query) ? strtok_r(query, "&", &sep) : NULL; opt;
+			opt = strtok_r(NULL, "&", &sep)) {
+		char	*val = strchr(opt, '=');
+
+		if (val)
+			*val++ = '\0';
+		if (0 == strcmp(opt, "baud")) {
+			if (!val)
+				devopen_err(uri, "No baud rate given");
+			baud = strtoul(val, NULL, 0);
+		} else if (0 == strcmp(opt, "binary"))
+			binary = (!val)||(0 != strcmp(val, "0"));
+		else
+			devopen_err(uri, "Unknown option");
+	}
+	// }}}
+
+	if ((baud != 0)&&(0 != strcmp(str, "tty")))
+		devopen_err(uri, "Only a tty has a baud rate");
+
+	if (0 == strcmp(str, "tcp")) {
+		host = path;
+		port = FPGAPORT;
+		colon = strrchr(path, ':');
+		if (colon) {
+			*colon = '\0';
+			port = strtoul(colon+1, NULL, 0);
+		}
+		if (!host[0])
+			host = FPGAHOST;
+		comms = new NETCOMMS(host, port);
+	} else if (0 == strcmp(str, "tty")) {
+		comms = new TTYCOMMS(path, baud);
+	} else if (0 == strcmp(str, "unix")) {
+		comms = new NETCOMMS((path[0]) ? path : FPGASOCK);
+	} else if (0 == strcmp(str, "replay")) {
+		comms = new REPLAYCOMMS(path);
+	} else if (0 == strcmp(str, "sim")) {
+		if (binary)
+			devopen_err(uri, "sim:// takes no options");
+		free(str);
+		return new SIMBUS();
+	} else
+		devopen_err(uri, "Unknown scheme");
+
+	if (binary)
+		dev = new BINBUS(comms);
+	else
+		dev = new FPGA(comms);
+
+	free(str);
+	return dev;
+}
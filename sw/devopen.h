@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	devopen.h
+// {{{
+// Project:	dbgbus, a collection of 8b channel to WB bus debugging protocols
+//
+// Purpose:	Opens a connection to the FPGA, given a URI describing how to get
+//		there, and returns a DEVBUS ready for use:
+//
+//	tcp://host:port		A TCP connection, such as to netuart or to
+//				the test bench.  Either part may be left out,
+//				defaulting to FPGAHOST and FPGAPORT.
+//	tty:///dev/ttyUSB2	A serial port.  ?baud=4000000 sets its rate,
+//				otherwise it's left as it is.
+//	unix:///path		A Unix domain socket, by default FPGASOCK,
+//				as netuart -u or testbus_tb -u may listen on
+//	sim://			A SIMBUS: memory simulated within this program
+//	replay://file		Plays back a capture of what the FPGA once
+//				sent, ignoring everything written
+//
+//	To any but sim://, the option
+//
+//	?binary			Speak the binary form of the protocol, if the
+//				FPGA can
+//
+//	may be added, joined with '&' to any others, as in
+//	tty:///dev/ttyUSB2?baud=4000000&binary.
+//
+//	Given no URI, $DBGBUS_URI is used instead.  Failing that, the URI is
+//	tcp://FPGAHOST:FPGAPORT, as set in port.h.
+
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2024, Gisselquist Technology, LLC
+// {{{
+// This file is part of the debugging interface demonstration.
+//
+// The debugging interface demonstration is free software (firmware): you can
+// redistribute it and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// This debugging interface demonstration is distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTIBILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+// General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  (It's in the $(ROOT)/doc directory.  Run make
+// with no target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	LGPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/lgpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	DEVOPEN_H
+#define	DEVOPEN_H
+
+#include "devbus.h"
+
+// Exits, with a message, should the URI not make sense or the device not
+// open
+extern	DEVBUS	*devopen(const char *uri = NULL);
+
+#endif
@@ -44,6 +44,8 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/un.h>
 #include <fcntl.h>
 #include <termios.h>
 #include <netinet/in.h>
@@ -58,6 +60,7 @@
 #include <strings.h> 
 #include <poll.h> 
 #include <ctype.h> 
+#include <time.h>
 
 #include "llcomms.h"
 
@@ -66,56 +69,366 @@ LLCOMMSI::LLCOMMSI(void) {
 	m_fdr = -1;
 	m_total_nread = 0l;
 	m_total_nwrit = 0l;
+	m_rxsize = LLCOMMS_RXRING;
+	m_rxbuf  = new char[m_rxsize];
+	m_rxhead = m_rxtail = 0;
+	m_txsize = LLCOMMS_TXMAX;
+	m_txbuf  = new char[m_txsize];
+	m_txhead = m_txtail = 0;
 }
 
+LLCOMMSI::~LLCOMMSI(void) {
+	close();
+	delete[] m_rxbuf;
+	delete[] m_txbuf;
+}
+
+// write
+// {{{
+// Queue the buffer, and send as much of it as the device will take right now.
+// Should more than LLCOMMS_TXMAX bytes then remain queued, wait for the device
+// to take enough of them to bring us back under that limit.
 void	LLCOMMSI::write(char *buf, int len) {
+	unsigned	fill;
+
+	if (len <= 0)
+		return;
+
+	fill = m_txhead - m_txtail;
+	if (m_txhead + len > m_txsize) {
+		if (fill + len > m_txsize) {
+			// Grow the queue to hold it all
+			unsigned	sz = m_txsize;
+			char		*nb;
+
+			while(sz < fill + len)
+				sz <<= 1;
+			nb = new char[sz];
+			memcpy(nb, &m_txbuf[m_txtail], fill);
+			delete[] m_txbuf;
+			m_txbuf  = nb;
+			m_txsize = sz;
+		} else
+			memmove(m_txbuf, &m_txbuf[m_txtail], fill);
+		m_txtail = 0;
+		m_txhead = fill;
+	}
+
+	memcpy(&m_txbuf[m_txhead], buf, len);
+	m_txhead += len;
+
+	txflush();
+	while(m_txhead - m_txtail > LLCOMMS_TXMAX)
+		txwait();
+}
+// }}}
+
+// flush
+// {{{
+// Wait until everything queued has been written to the device
+void	LLCOMMSI::flush(void) {
+	while(m_txhead != m_txtail)
+		txwait();
+}
+// }}}
+
+// txflush
+// {{{
+// Write as much of the output queue as the device will take without waiting
+void	LLCOMMSI::txflush(void) {
 	int	nw;
-	nw = ::write(m_fdw, buf, len);
-	if (nw <= 0) {
+
+	if (m_txhead == m_txtail)
+		return;
+
+	nw = ::write(m_fdw, &m_txbuf[m_txtail], m_txhead - m_txtail);
+	if (nw < 0) {
+		if ((errno == EAGAIN)||(errno == EWOULDBLOCK)||(errno == EINTR))
+			return;
 		throw "Write-Failure";
-	} else if (nw != len) {
-		fprintf(stderr, "LLCOMMSI::ERR: %d byte write request, only %d written\n", len, nw);
-		assert(nw == len);
 	}
+
 	m_total_nwrit += nw;
-	assert(nw == len);
+	m_txtail += nw;
+	if (m_txtail == m_txhead)
+		m_txhead = m_txtail = 0;
 }
+// }}}
 
-int	LLCOMMSI::read(char *buf, int len) {
-	int	nr;
-	nr = ::read(m_fdr, buf, len);
+// txwait
+// {{{
+// Wait for the device to take more of our output.  While we wait, keep
+// reading whatever the device sends back to us: the device may well be unable
+// to take any more until we do, and we'd otherwise both wait forever.
+void	LLCOMMSI::txwait(void) {
+	struct	pollfd	fds[2];
+
+	fds[0].fd = m_fdw;
+	fds[0].events = POLLOUT;
+	fds[0].revents = 0;
+	fds[1].fd = m_fdr;
+	fds[1].events = POLLIN;
+	fds[1].revents = 0;
+	::poll(fds, 2, -1);
+
+	if (fds[1].revents & (POLLIN|POLLHUP|POLLERR)) {
+		if (m_rxhead - m_rxtail >= m_rxsize)
+			rxgrow();
+		rxfill();
+	}
+
+	if (fds[0].revents & (POLLOUT|POLLHUP|POLLERR))
+		txflush();
+}
+// }}}
+
+// rxgrow
+// {{{
+// Double the size of the receive ring.  This only happens when the ring fills
+// while we're waiting to write, and can't leave the data in the device.
+void	LLCOMMSI::rxgrow(void) {
+	unsigned	fill = m_rxhead - m_rxtail;
+	char		*nb = new char[m_rxsize * 2];
+
+	for(unsigned k=0; k<fill; k++)
+		nb[k] = m_rxbuf[(m_rxtail + k) & (m_rxsize-1)];
+	delete[] m_rxbuf;
+	m_rxbuf  = nb;
+	m_rxsize = m_rxsize * 2;
+	m_rxtail = 0;
+	m_rxhead = fill;
+}
+// }}}
+
+// rxfill
+// {{{
+// Read as much as the device has, up to the contiguous free space in the
+// ring, in a single system call.
+void	LLCOMMSI::rxfill(void) {
+	unsigned	pos, room;
+	int		nr;
+
+	if (m_rxhead == m_rxtail)
+		// Start an empty ring over, so the whole of it may be filled
+		m_rxhead = m_rxtail = 0;
+
+	pos  = m_rxhead & (m_rxsize-1);
+	room = m_rxsize - (m_rxhead - m_rxtail);
+	if (room > m_rxsize - pos)
+		room = m_rxsize - pos;
+	if (room == 0)
+		return;
+
+	nr = ::read(m_fdr, &m_rxbuf[pos], room);
+	if ((nr < 0)&&((errno == EAGAIN)||(errno == EWOULDBLOCK)
+			||(errno == EINTR)))
+		return;
 	if (nr <= 0) {
 		throw "Read-Failure";
 	}
 	m_total_nread += nr;
+	m_rxhead += nr;
+}
+// }}}
+
+// read
+// {{{
+int	LLCOMMSI::read(char *buf, int len) {
+	unsigned	nr, pos, ln;
+
+	if (len <= 0)
+		return 0;
+
+	while(m_rxhead == m_rxtail) {
+		// Wait for something to read, sending anything queued while
+		// we wait
+		poll(LLCOMMS_FOREVER);
+
+		if ((unsigned)len >= m_rxsize) {
+			// Nothing is buffered, and the request is at least as
+			// large as the ring: skip the copy, and read straight
+			// into the caller's buffer
+			int	n = ::read(m_fdr, buf, len);
+			if (n > 0) {
+				m_total_nread += n;
+				return n;
+			} else if ((n == 0)||((errno != EAGAIN)
+					&&(errno != EWOULDBLOCK)
+					&&(errno != EINTR))) {
+				throw "Read-Failure";
+			}
+		} else
+			rxfill();
+	}
+
+	nr = m_rxhead - m_rxtail;
+	if (nr > (unsigned)len)
+		nr = len;
+
+	// Copy out, in (at most) two pieces if the data wraps around the ring
+	pos = m_rxtail & (m_rxsize-1);
+	ln  = m_rxsize - pos;
+	if (ln > nr)
+		ln = nr;
+	memcpy(buf, &m_rxbuf[pos], ln);
+	if (ln < nr)
+		memcpy(&buf[ln], m_rxbuf, nr - ln);
+	m_rxtail += nr;
+
 	return nr;
 }
+// }}}
+
+// peek, rxwait
+// {{{
+const char	*LLCOMMSI::peek(unsigned &len) const {
+	unsigned	pos = m_rxtail & (m_rxsize-1);
+
+	len = m_rxhead - m_rxtail;
+	if (len > m_rxsize - pos)
+		len = m_rxsize - pos;
+	return &m_rxbuf[pos];
+}
+
+bool	LLCOMMSI::rxwait(unsigned ms) {
+	if (m_rxhead != m_rxtail)
+		return true;
+	if (!poll(ms))
+		return false;
+	rxfill();
+	return true;
+}
+// }}}
 
 void	LLCOMMSI::close(void) {
+	// Give the device whatever we still owe it.  If it has gone away,
+	// there's nothing more to be done about that here.
+	if ((m_fdw >= 0)&&(m_txhead != m_txtail)) {
+		try {
+			flush();
+		} catch(const char *) {}
+	}
+	m_txhead = m_txtail = 0;
+
 	if(m_fdw>=0)
 		::close(m_fdw);
 	if((m_fdr>=0)&&(m_fdr != m_fdw))
 		::close(m_fdr);
 	m_fdw = m_fdr = -1;
+	m_rxhead = m_rxtail = 0;
 }
 
+// poll
+// {{{
+// Wait up to ms milliseconds for something to read.  Anything queued for the
+// device is written as the device will take it while we wait.
 bool	LLCOMMSI::poll(unsigned ms) {
-	struct	pollfd	fds;
+	struct	pollfd	fds[2];
+	struct	timespec	deadline, now;
+	int		tmo;
 
-	fds.fd = m_fdr;
-	fds.events = POLLIN;
-	::poll(&fds, 1, ms);
-
-	if (fds.revents & POLLIN) {
+	// Anything already in the ring can be read without waiting
+	if (m_rxhead != m_rxtail)
 		return true;
-	} else return false;
+
+	tmo = (ms == LLCOMMS_FOREVER) ? -1 : (int)ms;
+	if ((m_txhead != m_txtail)&&(tmo > 0)) {
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec  += ms / 1000;
+		deadline.tv_nsec += (ms % 1000) * 1000000l;
+		if (deadline.tv_nsec >= 1000000000l) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000l;
+		}
+	}
+
+	while(1) {
+		bool	sending = (m_txhead != m_txtail);
+
+		fds[0].fd = m_fdr;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+		fds[1].fd = m_fdw;
+		fds[1].events = POLLOUT;
+		fds[1].revents = 0;
+		::poll(fds, (sending) ? 2 : 1, tmo);
+
+		// A hang up, or error, is also something to read: the read
+		// will then fail, rather than leaving us waiting forever
+		if (fds[0].revents & (POLLIN|POLLHUP|POLLERR))
+			return true;
+		if ((!sending)||(!(fds[1].revents & (POLLOUT|POLLHUP|POLLERR))))
+			return false;
+
+		txflush();
+
+		// Then go back to waiting for whatever time we have left
+		if (tmo > 0) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if ((now.tv_sec > deadline.tv_sec)
+					||((now.tv_sec == deadline.tv_sec)
+					&&(now.tv_nsec >= deadline.tv_nsec)))
+				tmo = 0;
+			else
+				tmo = (deadline.tv_sec - now.tv_sec) * 1000
+					+ (deadline.tv_nsec - now.tv_nsec
+						+ 999999) / 1000000;
+		} else if ((tmo == 0)&&(m_txhead != m_txtail))
+			// Don't spin on a device that's taking our output
+			// a byte at a time
+			return false;
+	}
 }
+// }}}
 
 int	LLCOMMSI::available(void) {
-	return poll(0)?1:0;
+	int	nr = m_rxhead - m_rxtail, pending;
+
+	// Add whatever the kernel is holding for us.  Not every device will
+	// answer FIONREAD, so fall back to poll(), which can only tell us that
+	// at least one byte is waiting.
+	if (ioctl(m_fdr, FIONREAD, &pending) == 0)
+		nr += pending;
+	else if ((nr == 0)&&(poll(0)))
+		nr = 1;
+
+	return nr;
+}
+
+// ttyspeed
+// {{{
+// Returns the termios speed for a baud rate, or B0 if the rate isn't one we
+// can ask for
+static	speed_t	ttyspeed(const unsigned baud) {
+	static const struct { unsigned baud; speed_t speed; } rates[] = {
+		{    9600, B9600 },	{   19200, B19200 },
+		{   38400, B38400 },	{   57600, B57600 },
+		{  115200, B115200 },	{  230400, B230400 },
+#ifdef	B460800
+		{  460800, B460800 },	{  500000, B500000 },
+		{  576000, B576000 },	{  921600, B921600 },
+		{ 1000000, B1000000 },	{ 1152000, B1152000 },
+		{ 1500000, B1500000 },	{ 2000000, B2000000 },
+		{ 2500000, B2500000 },	{ 3000000, B3000000 },
+		{ 3500000, B3500000 },	{ 4000000, B4000000 },
+#endif
+		{ 0, B0 } };
+
+	for(int k=0; rates[k].baud; k++)
+		if (rates[k].baud == baud)
+			return rates[k].speed;
+	return B0;
 }
+// }}}
+
+TTYCOMMS::TTYCOMMS(const char *dev, const unsigned baud) {
+	speed_t	speed = B0;
+
+	if ((baud != 0)&&((speed = ttyspeed(baud)) == B0)) {
+		printf("\n Error : Unsupported baud rate, %u\n", baud);
+		exit(-1);
+	}
 
-TTYCOMMS::TTYCOMMS(const char *dev) {
 	m_fdr = ::open(dev, O_RDWR | O_NONBLOCK);
 	if (m_fdr < 0) {
 		printf("\n Error : Could not open %s\n", dev);
@@ -129,6 +442,8 @@ TTYCOMMS::TTYCOMMS(const char *dev) {
 		cfmakeraw(&tb);
 		// tb.c_iflag &= (~(IXON|IXOFF));
 		tb.c_cflag &= (~(CRTSCTS));
+		if (speed != B0)
+			cfsetspeed(&tb, speed);
 		tcsetattr(m_fdr, TCSANOW, &tb);
 		tcflow(m_fdr, TCOON);
 	}
@@ -163,6 +478,36 @@ NETCOMMS::NETCOMMS(const char *host, const int port) {
 		exit(-1);
 	} 
 
+	// Writes are queued, and sent only as the socket will take them
+	fcntl(m_fdr, F_SETFL, fcntl(m_fdr, F_GETFL) | O_NONBLOCK);
+
+	m_fdw = m_fdr;
+}
+
+NETCOMMS::NETCOMMS(const char *path) {
+	struct sockaddr_un serv_addr;
+
+	if (strlen(path) >= sizeof(serv_addr.sun_path)) {
+		printf("\n Error : Socket path too long, %s\n", path);
+		exit(-1);
+	}
+
+	if ((m_fdr = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		printf("\n Error : Could not create socket \n");
+		exit(-1);
+	}
+
+	memset(&serv_addr, 0, sizeof(serv_addr));
+	serv_addr.sun_family = AF_UNIX;
+	strcpy(serv_addr.sun_path, path);
+
+	if (connect(m_fdr,(struct sockaddr *)&serv_addr, sizeof(serv_addr))< 0){
+		perror("Connect Failed Err");
+		exit(-1);
+	}
+
+	fcntl(m_fdr, F_SETFL, fcntl(m_fdr, F_GETFL) | O_NONBLOCK);
+
 	m_fdw = m_fdr;
 }
 
@@ -170,6 +515,16 @@ void	NETCOMMS::close(void) {
 	int	nr;
 	char	buf[256];
 
+	if (m_fdw < 0)
+		return;
+
+	try {
+		flush();
+	} catch(const char *) {}
+	m_txhead = m_txtail = 0;
+
+	// Wait for the far end to close, discarding anything else it sends
+	fcntl(m_fdr, F_SETFL, fcntl(m_fdr, F_GETFL) & (~O_NONBLOCK));
 	shutdown(m_fdw, SHUT_WR);
 	while(1) {
 		nr = ::read(m_fdr, buf, sizeof(buf));
@@ -177,4 +532,22 @@ void	NETCOMMS::close(void) {
 			break;
 	}
 	::close(m_fdw);
+	m_fdw = m_fdr = -1;
+	m_rxhead = m_rxtail = 0;
+}
+
+REPLAYCOMMS::REPLAYCOMMS(const char *fname) {
+	m_fdr = ::open(fname, O_RDONLY);
+	if (m_fdr < 0) {
+		printf("\n Error : Could not open %s\n", fname);
+		perror("O/S Err:");
+		exit(-1);
+	}
+
+	// Whatever we're asked to send goes nowhere
+	m_fdw = ::open("/dev/null", O_WRONLY);
+	if (m_fdw < 0) {
+		perror("O/S Err:");
+		exit(-1);
+	}
 }
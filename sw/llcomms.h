@@ -43,20 +43,79 @@
 #ifndef	LLCOMMS_H
 #define	LLCOMMS_H
 
+// Given to poll(), waits for however long it takes
+#define	LLCOMMS_FOREVER	(~0u)
+
+// LLCOMMS_RXRING
+// {{{
+// The initial size of the receive ring, in bytes.  This must be a power of
+// two.  Reads are made from the device in blocks as large as the ring will
+// hold, so that the many small reads of a bus protocol are served from memory.
+// A protocol may also decode straight out of the ring, see peek().
+#define	LLCOMMS_RXRING	8192
+// }}}
+
+// LLCOMMS_TXMAX
+// {{{
+// The most output we'll hold queued for the device before write() waits for
+// the device to take some of it
+#define	LLCOMMS_TXMAX	65536
+// }}}
+
 class	LLCOMMSI {
 protected:
 	int	m_fdw, m_fdr;
+
+	// Bytes read from m_fdr, but not yet returned by read().  m_rxhead
+	// and m_rxtail only ever increase, and are taken modulo m_rxsize to
+	// index m_rxbuf.
+	char		*m_rxbuf;
+	unsigned	m_rxsize, m_rxhead, m_rxtail;
+
+	// Bytes given to write(), but not yet taken by m_fdw.  These are
+	// m_txbuf[m_txtail] up to (but not including) m_txbuf[m_txhead].
+	char		*m_txbuf;
+	unsigned	m_txsize, m_txhead, m_txtail;
+
 	LLCOMMSI(void);
+	void	rxfill(void);
+	void	rxgrow(void);
+	void	txflush(void);
+	void	txwait(void);
 public:
 	unsigned long	m_total_nread, m_total_nwrit;
 
-	virtual	~LLCOMMSI(void) { close(); }
+	virtual	~LLCOMMSI(void);
 	virtual	void	kill(void)  { this->close(); };
 	virtual	void	close(void);
 	virtual	void	write(char *buf, int len);
+	virtual	void	flush(void);
 	virtual int	read(char *buf, int len);
 	virtual	bool	poll(unsigned ms);
 
+	// The file descriptor data is read from, so that a program may wait on
+	// it together with anything else it's waiting on.  Bytes already in
+	// the receive ring won't show up on it, so check buffered() (or
+	// available()) before waiting--and flush() any output first, lest
+	// we wait on answers to requests that were never sent.
+	int	fd(void) const { return m_fdr; }
+
+	// The number of bytes in the receive ring, waiting to be read
+	unsigned	buffered(void) const { return m_rxhead - m_rxtail; }
+
+	// Rather than read() copying them out, the bytes in the receive ring
+	// may be decoded where they are.  peek() returns the oldest of them,
+	// together with how many follow before the ring wraps, leaving them
+	// in the ring until consume() is told how many were used.  rxwait()
+	// refills an empty ring, waiting up to ms milliseconds for something
+	// to arrive, and returns false if nothing did.
+	const char	*peek(unsigned &len) const;
+	void		consume(unsigned n) { m_rxtail += n; }
+	bool		rxwait(unsigned ms);
+
+	// The number of bytes queued, waiting for the device to take them
+	unsigned	queued(void) const { return m_txhead - m_txtail; }
+
 	// Tests whether or not bytes are available to be read, returns a 
 	// count of the bytes that may be immediately read
 	virtual	int	available(void); // { return 0; };
@@ -64,13 +123,27 @@ public:
 
 class	TTYCOMMS : public LLCOMMSI {
 public:
-	TTYCOMMS(const char *dev);
+	// A baud rate of zero leaves the port at whatever rate it's at
+	TTYCOMMS(const char *dev, const unsigned baud = 0);
 };
 
 class	NETCOMMS : public LLCOMMSI {
 public:
 	NETCOMMS(const char *dev, const int port);
+	// Connects to a Unix domain socket at path instead
+	NETCOMMS(const char *path);
 	virtual	void	close(void);
 };
 
+// REPLAYCOMMS
+// {{{
+// Plays back a capture of what the FPGA once sent, in place of the FPGA.
+// Anything written is discarded.  Reading past the end of the capture fails,
+// just as it would were the FPGA to hang up.
+class	REPLAYCOMMS : public LLCOMMSI {
+public:
+	REPLAYCOMMS(const char *fname);
+};
+// }}}
+
 #endif
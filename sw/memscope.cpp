@@ -50,15 +50,16 @@
 #include "regdefs.h"
 #include "scopecls.h"
 #include "hexbus.h"
+#include "devopen.h"
 
 #define	WBSCOPE		R_SCOPE
 #define	WBSCOPEDATA	R_SCOPD
 
-FPGA	*m_fpga;
+DEVBUS	*m_fpga;
 
 class	MEMSCOPE : public SCOPE {
 public:
-	MEMSCOPE(FPGA *fpga, unsigned addr) : SCOPE(fpga, addr) {};
+	MEMSCOPE(DEVBUS *fpga, unsigned addr) : SCOPE(fpga, addr) {};
 	~MEMSCOPE(void) {}
 
 	virtual	void	define_traces(void) {
@@ -95,9 +96,9 @@ public:
 };
 
 int main(int argc, char **argv) {
-	// Open and connect to our FPGA.  This macro needs to be defined in the
-	// include files above.
-	FPGAOPEN(m_fpga);
+	// Open and connect to our FPGA, as given by the first argument (a URI,
+	// see devopen.h) or otherwise by $DBGBUS_URI
+	m_fpga = devopen((argc > 1) ? argv[1] : NULL);
 
 	// Here, we open a scope.  An MEMSCOPE specifically.  The difference
 	// between an MEMSCOPE and any other scope is ... that the
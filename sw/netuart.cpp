@@ -46,6 +46,7 @@
 #include <fcntl.h>
 #include <termios.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <arpa/inet.h>
 #include <string.h>
 #include <poll.h>
@@ -122,6 +123,78 @@ int	setup_listener(const int port) {
 	return skt;
 }
 
+// remove_stale_socket
+// {{{
+// Removes a socket left behind at path by an earlier run.  Anything there that
+// isn't a socket, or is a socket something is still listening on, is left
+// alone, and we give up rather than take its place.
+static	void	remove_stale_socket(const char *path) {
+	struct	stat		sb;
+	struct	sockaddr_un	addr;
+	int	fd;
+
+	if (lstat(path, &sb) != 0) {
+		if (errno == ENOENT)
+			return;
+		perror("Could not stat socket path:");
+		exit(-1);
+	}
+
+	if (!S_ISSOCK(sb.st_mode)) {
+		fprintf(stderr, "%s exists, and is not a socket\n", path);
+		exit(-1);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ((fd >= 0)&&(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)) {
+		fprintf(stderr, "Something is already listening on %s\n", path);
+		exit(-1);
+	}
+	if (fd >= 0)
+		close(fd);
+
+	unlink(path);
+}
+// }}}
+
+int	setup_listener(const char *path) {
+	int	skt;
+	struct  sockaddr_un     my_addr;
+
+	if (strlen(path) >= sizeof(my_addr.sun_path)) {
+		fprintf(stderr, "Socket path too long, %s\n", path);
+		exit(-1);
+	}
+
+	skt = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (skt < 0) {
+		perror("Could not allocate socket: ");
+		exit(-1);
+	}
+
+	remove_stale_socket(path);
+	printf("Listening on %s\n", path);
+
+	memset(&my_addr, 0, sizeof(struct sockaddr_un)); // clear structure
+	my_addr.sun_family = AF_UNIX;
+	strcpy(my_addr.sun_path, path);
+
+	if (bind(skt, (struct sockaddr *)&my_addr, sizeof(my_addr))!=0) {
+		perror("BIND FAILED:");
+		exit(-1);
+	}
+
+	if (listen(skt, 1) != 0) {
+		perror("Listen failed:");
+		exit(-1);
+	}
+
+	return skt;
+}
+
 class	LINBUFS {
 public:
 	char	m_iline[512], m_oline[512];
@@ -282,11 +355,23 @@ int	myaccept(int skt, int timeout) {
 }
 
 int	main(int argc, char **argv) {
-	// First, accept a network connection
-	int	skt = setup_listener(FPGAPORT);
-	int	tty;
+	int	skt, tty;
 	bool	done = false;
 
+	// First, accept a network connection: on a Unix domain socket, given
+	// -u path, or else on FPGAPORT.  The path is always required, so it
+	// can never be mistaken for the tty that may follow it.
+	if ((argc > 1)&&(0 == strcmp(argv[1], "-u"))) {
+		if (argc < 3) {
+			fprintf(stderr, "ERR: -u requires a socket path, such as %s\n", FPGASOCK);
+			exit(-2);
+		}
+
+		skt = setup_listener(argv[2]);
+		argc -= 2; argv += 2;
+	} else
+		skt = setup_listener(FPGAPORT);
+
 	signal(SIGSTOP, sigstop);
 	signal(SIGBUS, sigbus);
 	signal(SIGSEGV, sigsegv);
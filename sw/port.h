@@ -51,7 +51,10 @@
 // anything had changed.
 #define	FPGAHOST	"localhost"	// Whatever computer is used to run this
 #define	FPGAPORT	9401		// A somewhat random port number--CHANGEME
+// Or, on this same computer, via a Unix domain socket, skipping the TCP stack
+#define	FPGASOCK	"/tmp/dbgbus.sock"
 
-#define FPGAOPEN(V) V= new FPGA(new NETCOMMS(FPGAHOST, FPGAPORT))
+// These are only the defaults.  Tools open the FPGA with devopen(), from
+// devopen.h, which takes a URI naming any of the ways to connect.
 
 #endif
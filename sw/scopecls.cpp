@@ -55,9 +55,13 @@
 
 // SCOPE::ready()
 // {{{
-bool	SCOPE::ready() {
+bool	SCOPE::ready(unsigned timeout) {
 	unsigned v;
-	v = m_fpga->readio(m_addr);
+	if (timeout)
+		v = m_fpga->readuntil(m_addr, 0x60000000, 0x60000000, timeout,
+			m_clkfreq_hz);
+	else
+		v = m_fpga->readio(m_addr);
 	if (m_scoplen == 0) {
 		m_scoplen = (1<<((v>>20)&0x01f));
 		m_holdoff = (v & ((1<<20)-1));
@@ -145,8 +149,22 @@ void	SCOPE::rawread(void) {
 	// If the bus works, you'll want to use readz(): read scoplen values
 	// into the buffer, from the address WBSCOPEDATA, without incrementing
 	// the address each time (hence the 'z' in readz--for zero increment).
+	//
+	// The vector read is issued as part of a batch, together with a second
+	// read of the control register.  That way the holdoff we use to find
+	// the trigger is read in the same exchange as the data it describes.
 	if (m_vector_read) {
-		m_fpga->readz(m_addr+4, m_scoplen, m_data);
+		BUSBATCH		batch(m_fpga);
+		BUSBATCH::HANDLE	hctrl, hdata;
+
+		hctrl = batch.readio(m_addr);
+		hdata = batch.readz(m_addr+4, m_scoplen, m_data);
+		batch.flush();
+
+		if (batch.err(hdata))
+			throw BUSERR(batch.erraddr(hdata));
+		if (!batch.err(hctrl))
+			m_holdoff = (batch.value(hctrl) & ((1<<20)-1));
 	} else {
 		for(unsigned int i=0; i<m_scoplen; i++)
 			m_data[i] = m_fpga->readio(m_addr+4);
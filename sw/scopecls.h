@@ -123,8 +123,10 @@ public:
 	}
 
 	// Query the scope: Is it ready?  Has it primed, triggered, and stopped?
-	// If so, this routine returns true, false otherwise.
-	bool	ready();
+	// If so, this routine returns true, false otherwise.  Given a timeout,
+	// in clocks, this waits up to that long for the scope to become ready,
+	// polling it from within the FPGA if the bus supports that.
+	bool	ready(unsigned timeout = 0);
 
 	// Read the control word from the scope, and send to the standard output
 	// a description of that.
@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	simbus.cpp
+// {{{
+// Project:	dbgbus, a collection of 8b channel to WB bus debugging protocols
+//
+// Purpose:	Implements the SIMBUS, a DEVBUS simulated in memory within the host
+//		program.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2024, Gisselquist Technology, LLC
+// {{{
+// This file is part of the debugging interface demonstration.
+//
+// The debugging interface demonstration is free software (firmware): you can
+// redistribute it and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// This debugging interface demonstration is distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTIBILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+// General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  (It's in the $(ROOT)/doc directory.  Run make
+// with no target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	LGPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/lgpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <time.h>
+#include <unistd.h>
+
+#include "llcomms.h"
+#include "simbus.h"
+
+SIMBUS::BUSW	SIMBUS::readio(const BUSW a) {
+	std::map<BUSW, BUSW>::const_iterator	it = m_mem.find(a & -4);
+
+	return (it == m_mem.end()) ? 0 : it->second;
+}
+
+void	SIMBUS::readi(const BUSW a, const int len, BUSW *buf) {
+	for(int k=0; k<len; k++)
+		buf[k] = readio(a + (k<<2));
+}
+
+void	SIMBUS::readz(const BUSW a, const int len, BUSW *buf) {
+	for(int k=0; k<len; k++)
+		buf[k] = readio(a);
+}
+
+void	SIMBUS::writei(const BUSW a, const int len, const BUSW *buf) {
+	for(int k=0; k<len; k++)
+		writeio(a + (k<<2), buf[k]);
+}
+
+void	SIMBUS::writez(const BUSW a, const int len, const BUSW *buf) {
+	for(int k=0; k<len; k++)
+		writeio(a, buf[k]);
+}
+
+// usleep
+// {{{
+// No interrupt will ever come, so this always sleeps the full time
+void	SIMBUS::usleep(unsigned msec) {
+	struct timespec	ts;
+
+	if (msec == LLCOMMS_FOREVER) {
+		wait();
+		return;
+	}
+
+	ts.tv_sec  = msec / 1000;
+	ts.tv_nsec = (msec % 1000) * 1000000l;
+	while(nanosleep(&ts, &ts) != 0)
+		;
+}
+// }}}
+
+void	SIMBUS::wait(void) {
+	while(1)
+		pause();
+}
@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	simbus.h
+// {{{
+// Project:	dbgbus, a collection of 8b channel to WB bus debugging protocols
+//
+// Purpose:	A DEVBUS simulated entirely within the host program, with no FPGA
+//		and no test bench behind it.  Every address holds a word of
+//	memory, initially zero, so that tools may be exercised (and their
+//	batches, fills, copies and CRCs checked) without any hardware.  There
+//	are no bus errors, and no interrupts.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2024, Gisselquist Technology, LLC
+// {{{
+// This file is part of the debugging interface demonstration.
+//
+// The debugging interface demonstration is free software (firmware): you can
+// redistribute it and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation, either version
+// 3 of the License, or (at your option) any later version.
+//
+// This debugging interface demonstration is distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+// of MERCHANTIBILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser
+// General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program.  (It's in the $(ROOT)/doc directory.  Run make
+// with no target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	LGPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/lgpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	SIMBUS_H
+#define	SIMBUS_H
+
+#include <map>
+#include "devbus.h"
+
+class	SIMBUS : public DEVBUS {
+	// Words of memory, by (word aligned) byte address.  Any never written
+	// read as zero.
+	std::map<BUSW, BUSW>	m_mem;
+public:
+	SIMBUS(void) {}
+
+	void	kill(void) {}
+	void	close(void) {}
+
+	void	writeio(const BUSW a, const BUSW v) { m_mem[a & -4] = v; }
+	BUSW	readio(const BUSW a);
+	void	readi(const BUSW a, const int len, BUSW *buf);
+	void	readz(const BUSW a, const int len, BUSW *buf);
+	void	writei(const BUSW a, const int len, const BUSW *buf);
+	void	writez(const BUSW a, const int len, const BUSW *buf);
+
+	bool	poll(void) { return false; }
+	void	usleep(unsigned msec);
+	void	wait(void);
+	bool	bus_err(void) const { return false; }
+	void	reset_err(void) {}
+	void	clear(void) {}
+};
+
+#endif
@@ -52,8 +52,9 @@
 #include "port.h"
 #include "regdefs.h"
 #include "hexbus.h"
+#include "devopen.h"
 
-FPGA	*m_fpga;
+DEVBUS	*m_fpga;
 void	closeup(int v) {
 	m_fpga->kill();
 	exit(0);
@@ -90,6 +91,11 @@ void	usage(void) {
 "\t-d\tIf given, specifies the value returned should be in decimal,\n"
 "\t\trather than hexadecimal.\n"
 "\n"
+"\t-u [uri]\tConnect to the FPGA described by [uri], such as\n"
+"\t\ttcp://host:port, tty:///dev/ttyUSB2?baud=4000000, unix:///path,\n"
+"\t\tsim://, or replay://file.  The default is $DBGBUS_URI, if set,\n"
+"\t\tor else tcp://%s:%d\n"
+"\n"
 "\t-n [host]\tAttempt to connect, via TCP/IP, to host named [host].\n"
 "\t\tThe default host is \'%s\'\n"
 "\n"
@@ -101,14 +107,15 @@ void	usage(void) {
 "\n"
 "\tIf a value is given, that value will be written to the indicated\n"
 "\taddress, otherwise the result from reading the address will be \n"
-"\twritten to the screen.\n", FPGAHOST, FPGAPORT);
+"\twritten to the screen.\n", FPGAHOST, FPGAPORT, FPGAHOST, FPGAPORT);
 }
 
 int main(int argc, char **argv) {
 	int	skp=0;
-	bool	use_decimal = false;
-	const char *host = FPGAHOST;
+	bool	use_decimal = false, use_net = false;
+	const char *host = FPGAHOST, *uri = NULL;
 	int	port=FPGAPORT;
+	char	tcpuri[256];
 
 	skp=1;
 	for(int argn=0; argn<argc-skp; argn++) {
@@ -121,6 +128,7 @@ int main(int argc, char **argv) {
 					exit(EXIT_SUCCESS);
 				}
 				host = argv[argn+skp+1];
+				use_net = true;
 				skp++; argn--;
 			} else if (argv[argn+skp][1] == 'p') {
 				if (argn+skp+1 >= argc) {
@@ -128,6 +136,14 @@ int main(int argc, char **argv) {
 					exit(EXIT_SUCCESS);
 				}
 				port = strtoul(argv[argn+skp+1], NULL, 0);
+				use_net = true;
+				skp++; argn--;
+			} else if (argv[argn+skp][1] == 'u') {
+				if (argn+skp+1 >= argc) {
+					fprintf(stderr, "ERR: No URI given\n");
+					exit(EXIT_SUCCESS);
+				}
+				uri = argv[argn+skp+1];
 				skp++; argn--;
 			} else {
 				usage();
@@ -138,7 +154,13 @@ int main(int argc, char **argv) {
 			argv[argn] = argv[argn+skp];
 	} argc -= skp;
 
-	m_fpga = new FPGA(new NETCOMMS(host, port));
+	// -n and -p are kept for those used to them
+	if ((!uri)&&(use_net)) {
+		snprintf(tcpuri, sizeof(tcpuri), "tcp://%s:%d", host, port);
+		uri = tcpuri;
+	}
+
+	m_fpga = devopen(uri);
 
 	signal(SIGSTOP, closeup);
 	signal(SIGHUP, closeup);